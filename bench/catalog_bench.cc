@@ -0,0 +1,108 @@
+// Filter and top-K kernels of CatalogColumns against the same work on an array of row structs, the shape the
+// catalog has when it is held as model objects.
+//
+//   catalog_bench [--rows N] [--rounds N]
+#include <tools/catalog_columns.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct RowStruct {
+        int32_t id;
+        std::string title;
+        std::string description;
+        std::string image;
+        double price;
+        int32_t quantity;
+        int64_t createdAt;
+        int64_t version;
+    };
+
+    template<typename F>
+    double bestMicros(size_t rounds, F &&run) {
+        double best = 1e300;
+        for (size_t i = 0; i < rounds; ++i) {
+            auto start = Clock::now();
+            run();
+            best = std::min(best, std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        return best;
+    }
+
+    volatile size_t sink;
+}
+
+int main(int argc, char *argv[]) {
+    size_t rows = 1000000;
+    size_t rounds = 20;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--rows") {
+            rows = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (arg == "--rounds") {
+            rounds = std::strtoull(argv[i + 1], nullptr, 10);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> price(1.0, 500.0);
+    std::uniform_int_distribution<int32_t> quantity(-5, 50);
+    CatalogColumns columns;
+    columns.reserve(rows);
+    std::vector<RowStruct> structs;
+    structs.reserve(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        RowStruct row{static_cast<int32_t>(i + 1), "Product " + std::to_string(i), "A product description", "",
+                      price(rng), quantity(rng), 1700000000000000 + static_cast<int64_t>(i) * 1000, 1};
+        columns.append(row.id, row.price, row.quantity, row.createdAt, row.version, row.title, row.description,
+                       row.image);
+        structs.push_back(std::move(row));
+    }
+    std::printf("%zu rows, %.1f MB of columns\n", rows, static_cast<double>(columns.bytes()) / (1 << 20));
+
+    CatalogColumns::Filter filter{50.0, 150.0, true};
+    auto columnar = bestMicros(rounds, [&] { sink = columns.select(filter).size(); });
+    auto rowWise = bestMicros(rounds, [&] {
+        std::vector<uint32_t> out;
+        for (size_t i = 0; i < structs.size(); ++i) {
+            const auto &row = structs[i];
+            if (row.price >= 50.0 && row.price <= 150.0 && row.quantity > 0) {
+                out.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        sink = out.size();
+    });
+    std::printf("filter    columns %10.1f us   row structs %10.1f us   (%zu rows match)\n", columnar, rowWise,
+                columns.select(filter).size());
+
+    const size_t limit = 51;
+    columnar = bestMicros(rounds, [&] {
+        sink = columns.top(filter, CatalogColumns::Order::PriceAsc, limit).size();
+    });
+    rowWise = bestMicros(rounds, [&] {
+        std::vector<const RowStruct *> matches;
+        for (const auto &row: structs) {
+            if (row.price >= 50.0 && row.price <= 150.0 && row.quantity > 0) {
+                matches.push_back(&row);
+            }
+        }
+        std::sort(matches.begin(), matches.end(), [](const RowStruct *a, const RowStruct *b) {
+            return a->price != b->price ? a->price < b->price : a->id < b->id;
+        });
+        matches.resize(std::min(matches.size(), limit));
+        sink = matches.size();
+    });
+    std::printf("top %zu    columns %10.1f us   row structs %10.1f us   (full sort)\n", limit, columnar, rowWise);
+    return 0;
+}
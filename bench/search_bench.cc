@@ -0,0 +1,155 @@
+// Compares product search served by the in-memory InvertedIndex against the Postgres full-text query.
+//
+//   search_bench [--docs N] [--queries N] [--pg "host=... dbname=... user=..."]
+//
+// Without --pg the index is filled with a synthetic corpus. With --pg it is loaded from productcrud
+// (db/migrations/005_productcrud_search.sql must be applied) and the same queries are timed against both.
+#include <tools/inverted_index.h>
+
+#include <drogon/orm/DbClient.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Timings {
+        std::vector<double> micros;
+
+        void add(Clock::time_point start) {
+            micros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+
+        double percentile(double p) {
+            if (micros.empty()) {
+                return 0;
+            }
+            std::sort(micros.begin(), micros.end());
+            return micros[std::min(micros.size() - 1, static_cast<size_t>(p * micros.size()))];
+        }
+
+        void print(const char *name) {
+            std::printf("%-10s p50 %9.1f us   p99 %9.1f us   (%zu queries)\n", name, percentile(0.50),
+                        percentile(0.99), micros.size());
+        }
+    };
+
+    // Zipf-ish vocabulary so that a few terms have long posting lists, like real product text
+    std::vector<std::string> vocabulary(size_t size) {
+        std::vector<std::string> words;
+        words.reserve(size);
+        for (size_t i = 0; i < size; ++i) {
+            words.push_back("w" + std::to_string(i));
+        }
+        return words;
+    }
+
+    std::string randomText(std::mt19937 &rng, const std::vector<std::string> &words, size_t length) {
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        std::string text;
+        for (size_t i = 0; i < length; ++i) {
+            auto rank = static_cast<size_t>(std::pow(static_cast<double>(words.size()), u(rng))) - 1;
+            text += words[rank];
+            text += ' ';
+        }
+        return text;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t docs = 200000;
+    size_t queries = 2000;
+    std::string conninfo;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--docs") {
+            docs = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (arg == "--queries") {
+            queries = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (arg == "--pg") {
+            conninfo = argv[i + 1];
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    InvertedIndex index;
+    std::mt19937 rng(42);
+    auto words = vocabulary(20000);
+    drogon::orm::DbClientPtr db;
+
+    auto loadStart = Clock::now();
+    if (conninfo.empty()) {
+        for (size_t id = 1; id <= docs; ++id) {
+            index.upsert(static_cast<uint32_t>(id), randomText(rng, words, 6), randomText(rng, words, 40));
+        }
+    } else {
+        db = drogon::orm::DbClient::newPgClient(conninfo, 1);
+        auto rows = db->execSqlSync("select id, title, description from productcrud");
+        for (const auto &row: rows) {
+            index.upsert(row["id"].as<uint32_t>(), row["title"].as<std::string>(),
+                         row["description"].as<std::string>());
+        }
+    }
+    std::printf("indexed %zu documents, %zu terms, %zu posting bytes in %.1f ms\n", index.documents(),
+                index.terms(), index.postingBytes(),
+                std::chrono::duration<double, std::milli>(Clock::now() - loadStart).count());
+
+    // two-term queries drawn from the frequent end of the vocabulary, where intersections are largest
+    std::vector<std::string> queryText;
+    if (conninfo.empty()) {
+        std::uniform_int_distribution<size_t> frequent(0, 200);
+        for (size_t i = 0; i < queries; ++i) {
+            queryText.push_back(words[frequent(rng)] + " " + words[frequent(rng)]);
+        }
+    } else {
+        auto titles = db->execSqlSync("select title from productcrud order by random() limit $1",
+                                      static_cast<int64_t>(queries));
+        for (const auto &row: titles) {
+            auto tokens = InvertedIndex::tokenize(row["title"].as<std::string>());
+            if (tokens.size() >= 2) {
+                queryText.push_back(tokens[0] + " " + tokens[1]);
+            } else if (!tokens.empty()) {
+                queryText.push_back(tokens[0]);
+            }
+        }
+    }
+
+    Timings all, any, postgres;
+    size_t hits = 0;
+    for (const auto &q: queryText) {
+        auto start = Clock::now();
+        hits += index.search(q, InvertedIndex::Match::All, 20).size();
+        all.add(start);
+        start = Clock::now();
+        hits += index.search(q, InvertedIndex::Match::Any, 20).size();
+        any.add(start);
+    }
+    if (db) {
+        for (const auto &q: queryText) {
+            auto start = Clock::now();
+            auto r = db->execSqlSync("select id, ts_rank_cd(search, query) as rank "
+                                     "from productcrud, websearch_to_tsquery('english', $1) query "
+                                     "where search @@ query order by rank desc, id desc limit 20",
+                                     q);
+            hits += r.size();
+            postgres.add(start);
+        }
+    }
+
+    all.print("index/all");
+    any.print("index/any");
+    if (db) {
+        postgres.print("postgres");
+    }
+    std::printf("(%zu hits)\n", hits);
+    return 0;
+}
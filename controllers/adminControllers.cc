@@ -0,0 +1,59 @@
+#include "adminControllers.h"
+#include <drogon/drogon.h>
+#include <models/Productcrud.h>
+#include <models/Usercase.h>
+#include <tools/cached_mapper.h>
+#include <tools/db_router.h>
+#include <tools/invalidation_bus.h>
+#include "productsControllers.h"
+
+using namespace drogon_model::shopapi;
+
+namespace {
+    template<typename T>
+    Json::Value cacheToJson() {
+        const auto &cache = CachedMapper<T>::cache();
+        Json::Value stats;
+        auto hits = cache.hits();
+        auto misses = cache.misses();
+        stats["size"] = static_cast<Json::UInt64>(cache.size());
+        stats["capacity"] = static_cast<Json::UInt64>(cache.capacity());
+        stats["hits"] = static_cast<Json::UInt64>(hits);
+        stats["misses"] = static_cast<Json::UInt64>(misses);
+        stats["evictions"] = static_cast<Json::UInt64>(cache.evictions());
+        stats["hit_ratio"] = hits + misses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+        return stats;
+    }
+}
+
+void adminControllers::cacheStats(const HttpRequestPtr &req,
+                                  std::function<void(const HttpResponsePtr &)> &&callback) {
+    Json::Value res;
+    res["status"] = "success";
+    res["data"]["products"] = cacheToJson<Productcrud>();
+    res["data"]["users"] = cacheToJson<Usercase>();
+    auto &listings = productsControllers::listingCache();
+    res["data"]["listings"]["size"] = static_cast<Json::UInt64>(listings.size());
+    res["data"]["listings"]["version"] = static_cast<Json::UInt64>(listings.version());
+    res["data"]["listings"]["hits"] = static_cast<Json::UInt64>(listings.hits());
+    res["data"]["listings"]["misses"] = static_cast<Json::UInt64>(listings.misses());
+    res["data"]["search_index"] = productsControllers::searchIndexStats();
+    res["data"]["suggest"] = productsControllers::suggestStats();
+    res["data"]["catalog_snapshot"] = productsControllers::catalogSnapshotStats();
+    res["data"]["invalidation"] = InvalidationBus::instance().stats();
+    auto resp = HttpResponse::newHttpJsonResponse(res);
+    resp->setStatusCode(k200OK);
+    callback(resp);
+}
+
+void adminControllers::dbStats(const HttpRequestPtr &req,
+                               std::function<void(const HttpResponsePtr &)> &&callback) {
+    Json::Value res;
+    res["status"] = "success";
+    res["data"]["routing"] = DbRouter::instance().stats();
+    res["data"]["pool"] = DbRouter::instance().poolStats();
+    res["data"]["insert_batching"] = productsControllers::insertBatchingStats();
+    auto resp = HttpResponse::newHttpJsonResponse(res);
+    resp->setStatusCode(k200OK);
+    callback(resp);
+}
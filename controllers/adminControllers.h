@@ -0,0 +1,20 @@
+#pragma once
+
+#include <drogon/HttpController.h>
+
+using namespace drogon;
+
+class adminControllers : public drogon::HttpController<adminControllers> {
+public:
+    METHOD_LIST_BEGIN
+        ADD_METHOD_TO(adminControllers::cacheStats, "/api/admin/cache", Get);
+        ADD_METHOD_TO(adminControllers::dbStats, "/api/admin/db", Get);
+    METHOD_LIST_END
+
+    // hit/miss counters of the read-through model caches, and the size of the in-memory search
+    // and typeahead indexes and of the catalog snapshot
+    static void cacheStats(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback);
+
+    // primary/replica routing (replica positions and where reads went), the adaptive pool and insert batching
+    static void dbStats(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback);
+};
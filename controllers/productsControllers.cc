@@ -4,6 +4,7 @@
 #include <models/Productcrud.h>
 #include <drogon/drogon.h>
 #include <drogon/orm/Mapper.h>
+#include <drogon/orm/DbListener.h>
 #include <filesystem>
 #include <fmt/core.h>
 #include <uuid/uuid.h>
@@ -12,6 +13,26 @@
 #include <optional>
 #include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+#include <limits>
+#include <mutex>
+#include <tools/page_cursor.h>
+#include <tools/pg_array.h>
+#include <tools/single_flight.h>
+#include <tools/cached_mapper.h>
+#include <tools/statement_registry.h>
+#include <tools/db_router.h>
+#include <tools/micro_batcher.h>
+#include <tools/stock_counter.h>
+#include <tools/inverted_index.h>
+#include <tools/prefix_index.h>
+#include <tools/catalog_columns.h>
+#include <tools/rcu_snapshot.h>
+#include <tools/invalidation_bus.h>
+#include <trantor/net/EventLoopThread.h>
 using namespace drogon;
 using namespace drogon::orm;
 using namespace std;
@@ -118,6 +139,1856 @@ namespace {
         LOG_DEBUG << "File saved successfully: " << targetPath;
         return targetPath;
     }
+
+    // Product fields carried by an update; unset members keep their stored value
+    struct ProductPatch {
+        std::optional<std::string> title;
+        std::optional<std::string> description;
+        std::optional<std::string> image;
+        std::optional<double> price;
+        std::optional<int> quantity;
+
+        bool empty() const {
+            return !title && !description && !image && !price && !quantity;
+        }
+    };
+
+    // Validate only the fields present in a patch
+    bool validateProductPatch(const ProductPatch &patch, std::string &errorMsg) {
+        if ((patch.title && patch.title->empty()) || (patch.description && patch.description->empty())) {
+            errorMsg = "Title and description must not be empty";
+            return false;
+        }
+        if (patch.price && *patch.price <= 0.0) {
+            errorMsg = "Price must be positive";
+            return false;
+        }
+        if (patch.quantity && *patch.quantity < 0) {
+            errorMsg = "Quantity must be non-negative";
+            return false;
+        }
+        return true;
+    }
+
+    // Parse product fields from multipart form-data or JSON; requireAll enforces the PUT contract
+    bool parseProductPatch(const HttpRequestPtr &req, bool requireAll, ProductPatch &patch, std::string &errorMsg) {
+        std::optional<std::string> contentType = req->getHeader("Content-Type");
+        if (contentType && contentType->find("multipart/form-data") != std::string::npos) {
+            LOG_DEBUG << "Parsing multipart/form-data request";
+            MultiPartParser parser;
+            if (parser.parse(req) != 0) {
+                LOG_ERROR << "Failed to parse multipart form data. Content-Type: " << *contentType;
+                errorMsg = "Failed to parse multipart form data. Ensure the fields and a valid image file (if provided) are included correctly.";
+                return false;
+            }
+
+            const auto &parameters = parser.getParameters();
+            LOG_DEBUG << "Form fields received: " << parameters.size();
+            auto field = [&parameters](const std::string &name) -> std::optional<std::string> {
+                auto it = parameters.find(name);
+                if (it == parameters.end() || it->second.empty()) {
+                    return std::nullopt;
+                }
+                return it->second;
+            };
+
+            patch.title = field("title");
+            patch.description = field("description");
+            try {
+                if (auto priceStr = field("price")) {
+                    patch.price = std::stod(*priceStr);
+                }
+                if (auto quantityStr = field("quantity")) {
+                    patch.quantity = std::stoi(*quantityStr);
+                }
+            } catch (const std::exception &e) {
+                LOG_ERROR << "Invalid price or quantity format: " << e.what();
+                errorMsg = "Invalid price or quantity format";
+                return false;
+            }
+
+            if (auto image = handleFileUpload(parser.getFiles(), errorMsg)) {
+                patch.image = *image;
+            } else if (!errorMsg.empty()) {
+                return false;
+            }
+        } else {
+            LOG_DEBUG << "Parsing JSON body";
+            auto json = req->getJsonObject();
+            if (!json || !json->isObject() || json->empty()) {
+                errorMsg = "Invalid or missing JSON body";
+                return false;
+            }
+
+            if ((json->isMember("price") && !(*json)["price"].isNumeric()) ||
+                (json->isMember("quantity") && !(*json)["quantity"].isInt())) {
+                errorMsg = "Invalid price or quantity format";
+                return false;
+            }
+
+            if (json->isMember("title")) patch.title = (*json)["title"].asString();
+            if (json->isMember("description")) patch.description = (*json)["description"].asString();
+            if (json->isMember("price")) patch.price = (*json)["price"].asDouble();
+            if (json->isMember("quantity")) patch.quantity = (*json)["quantity"].asInt();
+            if (json->isMember("image") && !(*json)["image"].asString().empty()) {
+                patch.image = (*json)["image"].asString();
+            }
+        }
+
+        if (requireAll && (!patch.title || !patch.description || !patch.price || !patch.quantity)) {
+            errorMsg = "All required fields (title, description, price, quantity) must be provided";
+            return false;
+        }
+        if (patch.empty()) {
+            errorMsg = "No product fields to update";
+            return false;
+        }
+        return validateProductPatch(patch, errorMsg);
+    }
+
+    // Every product query is a named statement, see registerProductStatements() below
+    const PreparedStatement &productStatement(const std::string &name);
+
+    const std::string &sqlForPatchingProduct() {
+        static const std::string &sql = productStatement("products.patch").sql;
+        return sql;
+    }
+
+    const std::string &sqlForPatchingProductIfVersion() {
+        static const std::string &sql = productStatement("products.patch_if_version").sql;
+        return sql;
+    }
+
+    const std::string &sqlForDeletingProductIfVersion() {
+        static const std::string &sql = productStatement("products.delete_if_version").sql;
+        return sql;
+    }
+
+    const std::string &sqlForProductVersion() {
+        static const std::string &sql = productStatement("products.version").sql;
+        return sql;
+    }
+
+    const std::string &sqlForReservingStock() {
+        static const std::string &sql = productStatement("products.reserve").sql;
+        return sql;
+    }
+
+    const std::string &sqlForAdjustingStock() {
+        static const std::string &sql = productStatement("products.adjust_quantity").sql;
+        return sql;
+    }
+
+    const std::string &sqlForProductQuantity() {
+        static const std::string &sql = productStatement("products.quantity").sql;
+        return sql;
+    }
+
+    const std::string &sqlForLeasingStock() {
+        static const std::string &sql = productStatement("products.lease_stock").sql;
+        return sql;
+    }
+
+    // Strong ETag of a product; the version column changes on every write (db/migrations/004_productcrud_version.sql)
+    std::string productEtag(int64_t version) {
+        return fmt::format("\"{}\"", version);
+    }
+
+    // If-Match of a product write. expected stays empty when the header is absent or "*";
+    // false when it cannot match any version (a weak or malformed tag), which is answered like a mismatch
+    bool parseIfMatch(const HttpRequestPtr &req, std::optional<int64_t> &expected) {
+        const auto &ifMatch = req->getHeader("If-Match");
+        if (ifMatch.empty() || ifMatch == "*") {
+            return true;
+        }
+        if (ifMatch.size() < 3 || ifMatch.front() != '"' || ifMatch.back() != '"') {
+            return false;
+        }
+        int64_t version = 0;
+        auto first = ifMatch.data() + 1;
+        auto last = ifMatch.data() + ifMatch.size() - 1;
+        auto [ptr, ec] = std::from_chars(first, last, version);
+        if (ec != std::errc() || ptr != last) {
+            return false;
+        }
+        expected = version;
+        return true;
+    }
+
+    // custom_config.products.require_if_match turns a missing If-Match into 428 Precondition Required
+    bool ifMatchRequired() {
+        static const bool required =
+            app().getCustomConfig()["products"].get("require_if_match", false).asBool();
+        return required;
+    }
+
+    HttpResponsePtr createPreconditionFailedResponse(std::optional<int64_t> current) {
+        auto resp = createErrorResponse("Product was modified by another request; fetch it again and retry",
+                                        k412PreconditionFailed);
+        if (current) {
+            resp->addHeader("ETag", productEtag(*current));
+        }
+        return resp;
+    }
+
+    // A conditional write touched no row: tell a stale If-Match (412) apart from a missing product (404)
+    void respondToConditionalMiss(const DbClientPtr &client, int id,
+                                  const std::function<void(const HttpResponsePtr &)> &callback) {
+        client->execSqlAsync(
+            sqlForProductVersion(),
+            [callback, id](const Result &r) {
+                if (r.empty()) {
+                    LOG_ERROR << "Product not found: id=" << id;
+                    callback(createErrorResponse("Product not found", k404NotFound));
+                    return;
+                }
+                LOG_INFO << "If-Match failed for product " << id;
+                callback(createPreconditionFailedResponse(r[0]["version"].as<int64_t>()));
+            },
+            [callback](const DrogonDbException &e) {
+                LOG_ERROR << "Database error: " << e.base().what();
+                callback(createErrorResponse(fmt::format("Database error: {}", e.base().what()),
+                                             k500InternalServerError));
+            },
+            id);
+    }
+
+    // Every column the API returns, in table order; the search tsvector in the table is never selected
+    const std::vector<std::string> &productColumns() {
+        static const std::vector<std::string> columns = {
+            Productcrud::Cols::_id, Productcrud::Cols::_title, Productcrud::Cols::_description,
+            Productcrud::Cols::_image, Productcrud::Cols::_price, Productcrud::Cols::_quantity,
+            Productcrud::Cols::_created_at, Productcrud::Cols::_version
+        };
+        return columns;
+    }
+
+    const std::string &productColumnList() {
+        static const std::string list = [] {
+            std::string list;
+            for (const auto &column: productColumns()) {
+                list += list.empty() ? column : "," + column;
+            }
+            return list;
+        }();
+        return list;
+    }
+
+    // Columns selected through ?fields=; an empty set means every column
+    struct ProductFields {
+        std::vector<std::string> columns; // quoted names from Productcrud::Cols, in table order
+
+        bool all() const {
+            return columns.empty();
+        }
+
+        // required columns are fetched even when the client did not ask for them (keyset and id lookups need them)
+        std::string selectList(const std::vector<std::string> &required = {}) const {
+            if (all()) {
+                return productColumnList();
+            }
+            std::string list;
+            for (const auto &column: columns) {
+                list += list.empty() ? column : "," + column;
+            }
+            for (const auto &column: required) {
+                if (std::find(columns.begin(), columns.end(), column) == columns.end()) {
+                    list += "," + column;
+                }
+            }
+            return list;
+        }
+
+        // serialise only the selected columns, straight from the row
+        Json::Value toJson(const Row &row) const {
+            if (all()) {
+                return Productcrud(row).toJson();
+            }
+            Json::Value ret;
+            for (const auto &column: columns) {
+                std::string name = column.substr(1, column.size() - 2);
+                const auto &field = row[name];
+                if (field.isNull()) {
+                    ret[name] = Json::Value();
+                } else if (column == Productcrud::Cols::_id || column == Productcrud::Cols::_quantity) {
+                    ret[name] = field.as<int32_t>();
+                } else if (column == Productcrud::Cols::_version) {
+                    ret[name] = static_cast<Json::Int64>(field.as<int64_t>());
+                } else if (column == Productcrud::Cols::_price) {
+                    ret[name] = field.as<double>();
+                } else {
+                    ret[name] = field.as<std::string>();
+                }
+            }
+            return ret;
+        }
+    };
+
+    // Parse ?fields=id,title,... against Productcrud::Cols
+    bool parseProductFields(const std::string &param, ProductFields &fields, std::string &errorMsg) {
+        if (param.empty()) {
+            return true;
+        }
+        const auto &knownColumns = productColumns();
+
+        std::vector<bool> selected(knownColumns.size(), false);
+        size_t begin = 0;
+        while (begin <= param.size()) {
+            size_t end = param.find(',', begin);
+            if (end == std::string::npos) {
+                end = param.size();
+            }
+            std::string quoted = "\"" + param.substr(begin, end - begin) + "\"";
+            auto it = std::find(knownColumns.begin(), knownColumns.end(), quoted);
+            if (it == knownColumns.end()) {
+                errorMsg = fmt::format("Unknown field '{}'", param.substr(begin, end - begin));
+                return false;
+            }
+            selected[it - knownColumns.begin()] = true;
+            begin = end + 1;
+        }
+        for (size_t i = 0; i < knownColumns.size(); ++i) {
+            if (selected[i]) {
+                fields.columns.push_back(knownColumns[i]);
+            }
+        }
+        return true;
+    }
+
+    // Keyset pagination over (created_at, id), newest first; see db/migrations/003_productcrud_keyset_index.sql
+    constexpr int64_t kDefaultPageSize = 50;
+    constexpr int64_t kMaxPageSize = 200;
+
+    std::string buildFirstProductPageSql(const ProductFields &fields) {
+        return "select " + fields.selectList({Productcrud::Cols::_id, Productcrud::Cols::_created_at}) +
+               " from " + Productcrud::tableName +
+               " order by created_at desc, id desc limit $1";
+    }
+
+    std::string buildProductPageAfterSql(const ProductFields &fields) {
+        return "select " + fields.selectList({Productcrud::Cols::_id, Productcrud::Cols::_created_at}) +
+               " from " + Productcrud::tableName +
+               " where (created_at, id) < ($1::timestamp, $2)"
+               " order by created_at desc, id desc limit $3";
+    }
+
+    std::string buildProductByIdSql(const ProductFields &fields) {
+        return "select " + fields.selectList({Productcrud::Cols::_version}) + " from " + Productcrud::tableName +
+               " where id = $1";
+    }
+
+    // Whole-row queries are registered (and warmed) up front; a ?fields= projection becomes its own
+    // named statement the first time it is requested
+    const std::string &projectedSql(const std::string &name, const ProductFields &fields,
+                                    std::string (*build)(const ProductFields &)) {
+        if (fields.all()) {
+            return productStatement(name).sql;
+        }
+        return StatementRegistry::instance()
+            .getOrAdd(name + '(' + fields.selectList() + ')', [&fields, build]() { return build(fields); })
+            .sql;
+    }
+
+    const std::string &sqlForFirstProductPage(const ProductFields &fields) {
+        return projectedSql("products.page_first", fields, buildFirstProductPageSql);
+    }
+
+    const std::string &sqlForProductPageAfter(const ProductFields &fields) {
+        return projectedSql("products.page_after", fields, buildProductPageAfterSql);
+    }
+
+    const std::string &sqlForProductById(const ProductFields &fields) {
+        return projectedSql("products.by_id", fields, buildProductByIdSql);
+    }
+
+    // Outcome of a product lookup, serialised once and shared by every request coalesced onto it
+    struct ProductLookupResult {
+        Json::Value data;  // null when the product does not exist
+        std::string error; // set when the query failed
+        int64_t version = 0;
+    };
+    using ProductLookups = SingleFlight<std::string, ProductLookupResult>;
+    ProductLookups productLookups;
+
+    // Multi-get: the whole id list is bound as one integer[] parameter
+    constexpr size_t kMaxLookupIds = 1000;
+
+    std::string buildProductsByIdsSql(const ProductFields &fields) {
+        return "select " + fields.selectList({Productcrud::Cols::_id}) + " from " + Productcrud::tableName +
+               " where id = any($1::integer[])";
+    }
+
+    const std::string &sqlForProductsByIds(const ProductFields &fields) {
+        return projectedSql("products.by_ids", fields, buildProductsByIdsSql);
+    }
+
+    // Full-text search over the generated tsvector (db/migrations/005_productcrud_search.sql), best match first;
+    // keyset pagination walks (rank, id) so later pages do not re-rank what was already returned
+    constexpr size_t kMaxSearchQueryLength = 256;
+
+    std::string buildSearchSql(const ProductFields &fields, bool after, bool highlight) {
+        std::vector<std::string> required = {Productcrud::Cols::_id};
+        if (highlight) {
+            required.push_back(Productcrud::Cols::_description);
+        }
+        std::string sql = "select " + fields.selectList(required) + ", ts_rank_cd(search, query) as rank from " +
+                          Productcrud::tableName + ", websearch_to_tsquery('english', $1) query where search @@ query";
+        sql += after ? " and (ts_rank_cd(search, query), id) < ($2::real, $3) order by rank desc, id desc limit $4"
+                     : " order by rank desc, id desc limit $2";
+        if (!highlight) {
+            return sql;
+        }
+        // snippets are cut only for the rows of the page, after the limit
+        return "select page.*, ts_headline('english', page.description, websearch_to_tsquery('english', $1),"
+               " 'MaxFragments=2, MaxWords=20, MinWords=5') as snippet from (" +
+               sql + ") page order by rank desc, id desc";
+    }
+
+    std::string searchStatementName(bool after, bool highlight) {
+        return std::string(after ? "products.search_after" : "products.search_first") +
+               (highlight ? "_highlight" : "");
+    }
+
+    const std::string &sqlForSearch(const ProductFields &fields, bool after, bool highlight) {
+        auto name = searchStatementName(after, highlight);
+        if (fields.all()) {
+            return productStatement(name).sql;
+        }
+        return StatementRegistry::instance()
+            .getOrAdd(name + '(' + fields.selectList() + ')',
+                      [&fields, after, highlight]() { return buildSearchSql(fields, after, highlight); })
+            .sql;
+    }
+
+    // the rank is compared as a real, so the cursor keeps it as a float parsed from Postgres' own text
+    float parseRank(const Field &field) {
+        auto text = field.as<std::string>();
+        float rank = 0;
+        std::from_chars(text.data(), text.data() + text.size(), rank);
+        return rank;
+    }
+
+    std::string formatRank(float rank) {
+        char text[32];
+        auto [end, ec] = std::to_chars(text, text + sizeof(text), rank);
+        (void)ec;
+        return std::string(text, end);
+    }
+
+    // Parse ids=1,2,3; duplicates are dropped, the first occurrence keeps its position
+    bool parseProductIds(const std::string &param, std::vector<int32_t> &ids, std::string &errorMsg) {
+        std::unordered_set<int32_t> seen;
+        size_t begin = 0;
+        while (begin < param.size()) {
+            size_t end = param.find(',', begin);
+            if (end == std::string::npos) {
+                end = param.size();
+            }
+            int32_t id = 0;
+            auto [ptr, ec] = std::from_chars(param.data() + begin, param.data() + end, id);
+            if (ec != std::errc() || ptr != param.data() + end) {
+                errorMsg = fmt::format("Invalid product id '{}'", param.substr(begin, end - begin));
+                return false;
+            }
+            if (seen.insert(id).second) {
+                if (ids.size() == kMaxLookupIds) {
+                    errorMsg = fmt::format("At most {} ids can be looked up at once", kMaxLookupIds);
+                    return false;
+                }
+                ids.push_back(id);
+            }
+            begin = end + 1;
+        }
+        if (ids.empty()) {
+            errorMsg = "ids must list at least one product id";
+            return false;
+        }
+        return true;
+    }
+
+    // Resolve every id with one query and answer in request order, listing the ids that do not exist
+    void lookupProductsByIds(const DbClientPtr &client, const std::vector<int32_t> &ids, const ProductFields &fields,
+                             const std::function<void(const HttpResponsePtr &)> &callback) {
+        std::vector<std::string> idStrings;
+        idStrings.reserve(ids.size());
+        for (auto id: ids) {
+            idStrings.push_back(std::to_string(id));
+        }
+
+        client->execSqlAsync(
+            sqlForProductsByIds(fields),
+            [callback, ids, fields](const Result &r) {
+                std::unordered_map<int32_t, size_t> rowById;
+                rowById.reserve(r.size());
+                for (size_t i = 0; i < r.size(); ++i) {
+                    rowById.emplace(r[i]["id"].as<int32_t>(), i);
+                }
+
+                Json::Value data(Json::arrayValue);
+                Json::Value missing(Json::arrayValue);
+                for (auto id: ids) {
+                    auto it = rowById.find(id);
+                    if (it == rowById.end()) {
+                        missing.append(id);
+                    } else {
+                        data.append(fields.toJson(r[it->second]));
+                    }
+                }
+
+                Json::Value res;
+                res["status"] = "success";
+                res["data"] = data;
+                res["missing"] = missing;
+                auto resp = HttpResponse::newHttpJsonResponse(res);
+                resp->setStatusCode(k200OK);
+                callback(resp);
+            },
+            [callback](const DrogonDbException &e) {
+                LOG_ERROR << "Database error: " << e.base().what();
+                callback(createErrorResponse(fmt::format("Database error: {}", e.base().what()),
+                                             k500InternalServerError));
+            },
+            to_pg_array_literal(idStrings));
+    }
+
+    // Stream mode reads this many rows per round trip, which bounds the memory held per request
+    constexpr int64_t kStreamBatchSize = 500;
+
+    // Send the listing one keyset batch at a time; each row is serialised straight from the Result
+    void streamProductBatches(const DbClientPtr &client, const std::shared_ptr<ResponseStream> &stream,
+                              const ProductFields &fields, const std::optional<PageCursor> &cursor,
+                              int64_t remaining, bool first) {
+        int64_t batch = std::min(remaining, kStreamBatchSize);
+        auto onRows = [client, stream, fields, remaining, batch, first](const Result &r) {
+            Json::StreamWriterBuilder writer;
+            writer["indentation"] = "";
+            std::string chunk;
+            for (size_t i = 0; i < r.size(); ++i) {
+                if (!first || i > 0) {
+                    chunk += ',';
+                }
+                chunk += Json::writeString(writer, fields.toJson(r[i]));
+            }
+
+            bool more = static_cast<int64_t>(r.size()) == batch && remaining > batch;
+            if (!more) {
+                chunk += "]}";
+            }
+            if (!stream->send(chunk)) {
+                LOG_DEBUG << "Client went away while streaming products";
+                stream->close();
+                return;
+            }
+            if (!more) {
+                stream->close();
+                return;
+            }
+
+            const auto &last = r[r.size() - 1];
+            PageCursor next{last["created_at"].as<std::string>(), last["id"].as<int32_t>()};
+            streamProductBatches(client, stream, fields, next, remaining - batch, false);
+        };
+        auto onError = [stream](const DrogonDbException &e) {
+            // the status line is already sent, an unterminated body is all that is left to signal the failure
+            LOG_ERROR << "Database error while streaming products: " << e.base().what();
+            stream->close();
+        };
+
+        if (cursor) {
+            client->execSqlAsync(sqlForProductPageAfter(fields), std::move(onRows), std::move(onError),
+                                 cursor->created_at, cursor->id, batch);
+        } else {
+            client->execSqlAsync(sqlForFirstProductPage(fields), std::move(onRows), std::move(onError), batch);
+        }
+    }
+
+    // Bulk creation: one statement regardless of the batch size, each column is bound as an array
+    constexpr size_t kMaxBatchItems = 5000;
+
+    const std::string &sqlForInsertingProductBatch() {
+        static const std::string &sql = productStatement("products.insert_batch").sql;
+        return sql;
+    }
+
+    const std::string &sqlForInsertingProduct() {
+        static const std::string &sql = productStatement("products.insert").sql;
+        return sql;
+    }
+
+    // The product statements and the arguments they are warmed with. Warm-up runs inside a transaction
+    // that is rolled back, so the arguments only need the right types and must not make the statement fail.
+    void registerProductStatements() {
+        using Binder = PreparedStatement::Binder;
+        auto &registry = StatementRegistry::instance();
+        const auto &table = Productcrud::tableName;
+        const ProductFields allFields;
+        // never "returning *": that would ship the search tsvector back with every written row
+        const std::string returning = " returning " + productColumnList();
+
+        // the texts drogon::orm::Mapper issues for findByPrimaryKey / deleteByPrimaryKey (CachedMapper)
+        registry.add("products.find_by_pk", Productcrud::sqlForFindingByPrimaryKey(),
+                     [](Binder &binder) { binder << int32_t(-1); });
+        registry.add("products.delete_by_pk", Productcrud::sqlForDeletingByPrimaryKey(),
+                     [](Binder &binder) { binder << int32_t(-1); });
+
+        registry.add("products.insert",
+                     "insert into " + table + " (title, description, image, price, quantity)"
+                     " values ($1, $2, $3, $4, $5)" + returning,
+                     [](Binder &binder) {
+                         binder << std::string() << std::string() << std::string() << 0.0 << int32_t(0);
+                     });
+        registry.add("products.insert_batch",
+                     "insert into " + table + " (title, description, image, price, quantity)"
+                     " select * from unnest($1::text[], $2::text[], $3::text[],"
+                     " $4::double precision[], $5::integer[])" + returning,
+                     [](Binder &binder) {
+                         binder << std::string("{}") << std::string("{}") << std::string("{}") << std::string("{}")
+                                << std::string("{}");
+                     });
+
+        // One statement per update: NULL parameters fall back to the stored column value
+        const std::string patch = "update " + table +
+                                  " set title = coalesce($2, title), description = coalesce($3, description),"
+                                  " image = coalesce($4, image), price = coalesce($5, price),"
+                                  " quantity = coalesce($6, quantity)"
+                                  " where id = $1";
+        auto bindEmptyPatch = [](Binder &binder) {
+            binder << int32_t(-1) << nullptr << nullptr << nullptr << nullptr << nullptr;
+        };
+        registry.add("products.patch", patch + returning, bindEmptyPatch);
+        // Same update, applied only while the row still has the version the client read (If-Match)
+        registry.add("products.patch_if_version", patch + " and version = $7" + returning,
+                     [bindEmptyPatch](Binder &binder) {
+                         bindEmptyPatch(binder);
+                         binder << int64_t(0);
+                     });
+        registry.add("products.delete_if_version", "delete from " + table + " where id = $1 and version = $2",
+                     [](Binder &binder) { binder << int32_t(-1) << int64_t(0); });
+        registry.add("products.version", "select version from " + table + " where id = $1",
+                     [](Binder &binder) { binder << int32_t(-1); });
+
+        // Stock changes are single statements, so concurrent checkouts never read-modify-write the row
+        registry.add("products.reserve",
+                     "update " + table + " set quantity = quantity - $2 where id = $1 and quantity >= $2"
+                     " returning quantity, version",
+                     [](Binder &binder) { binder << int32_t(-1) << int32_t(0); });
+        // never below zero: no row comes back when the change would take more than is left
+        registry.add("products.adjust_quantity",
+                     "update " + table + " set quantity = quantity + $2 where id = $1 and quantity + $2 >= 0"
+                     " returning quantity, version",
+                     [](Binder &binder) { binder << int32_t(-1) << int32_t(0); });
+        registry.add("products.quantity", "select quantity, version from " + table + " where id = $1",
+                     [](Binder &binder) { binder << int32_t(-1); });
+        // hot SKU lease: up to $2 units, fewer when less is left; no row when nothing is left or it does not exist
+        registry.add("products.lease_stock",
+                     "with left_over as (select id, quantity from " + table + " where id = $1 and quantity > 0"
+                     " for update) update " + table + " set quantity = " + table + ".quantity"
+                     " - least(left_over.quantity, $2) from left_over where " + table + ".id = left_over.id"
+                     " returning least(left_over.quantity, $2) as leased, " + table + ".quantity, " + table +
+                     ".version",
+                     [](Binder &binder) { binder << int32_t(-1) << int32_t(0); });
+
+        registry.add("products.page_first", buildFirstProductPageSql(allFields),
+                     [](Binder &binder) { binder << int64_t(0); });
+        registry.add("products.page_after", buildProductPageAfterSql(allFields),
+                     [](Binder &binder) { binder << std::string("1970-01-01 00:00:00") << int32_t(0) << int64_t(0); });
+        registry.add("products.by_id", buildProductByIdSql(allFields),
+                     [](Binder &binder) { binder << int32_t(-1); });
+        registry.add("products.by_ids", buildProductsByIdsSql(allFields),
+                     [](Binder &binder) { binder << std::string("{}"); });
+        registry.add("products.index_batch",
+                     "select id, title, description from " + table + " where id > $1 order by id limit $2",
+                     [](Binder &binder) { binder << int32_t(0) << int64_t(0); });
+        registry.add("products.titles", "select id, title from " + table);
+        registry.add("products.catalog", "select " + productColumnList() + " from " + table + " order by id");
+        for (bool highlight: {false, true}) {
+            registry.add(searchStatementName(false, highlight), buildSearchSql(allFields, false, highlight),
+                         [](Binder &binder) { binder << std::string("warmup") << int64_t(0); });
+            registry.add(searchStatementName(true, highlight), buildSearchSql(allFields, true, highlight),
+                         [](Binder &binder) {
+                             binder << std::string("warmup") << std::string("0") << int32_t(0) << int64_t(0);
+                         });
+        }
+    }
+
+    const PreparedStatement &productStatement(const std::string &name) {
+        productsControllers::registerStatements();
+        return StatementRegistry::instance().get(name);
+    }
+
+    // Validate one element of a batch the same way createProducts validates a single product
+    bool parseBatchItem(const Json::Value &item, Productcrud &product, std::string &errorMsg) {
+        if (!item.isObject()) {
+            errorMsg = "Item must be a JSON object";
+            return false;
+        }
+        if (!item["title"].isString() || !item["description"].isString() ||
+            !item["price"].isNumeric() || !item["quantity"].isInt()) {
+            errorMsg = "Missing or invalid fields: title, description, price, quantity";
+            return false;
+        }
+        if (item.isMember("image") && !item["image"].isString()) {
+            errorMsg = "image must be a string";
+            return false;
+        }
+
+        std::string title = item["title"].asString();
+        std::string description = item["description"].asString();
+        double price = item["price"].asDouble();
+        int quantity = item["quantity"].asInt();
+        if (!validateProductFields(title, description, price, quantity, errorMsg)) {
+            return false;
+        }
+
+        product.setTitle(title);
+        product.setDescription(description);
+        product.setPrice(price);
+        product.setQuantity(quantity);
+        product.setImage(item.isMember("image") ? item["image"].asString() : "");
+        return true;
+    }
+
+    // Read the batch body, either a JSON array or NDJSON (one object per line)
+    bool parseBatchBody(const HttpRequestPtr &req, std::vector<Json::Value> &items, std::string &errorMsg) {
+        const auto &contentType = req->getHeader("Content-Type");
+        if (contentType.find("application/x-ndjson") != std::string::npos) {
+            Json::CharReaderBuilder builder;
+            std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+            std::string_view body = req->getBody();
+            size_t begin = 0;
+            while (begin < body.size()) {
+                size_t end = body.find('\n', begin);
+                if (end == std::string_view::npos) {
+                    end = body.size();
+                }
+                auto line = body.substr(begin, end - begin);
+                begin = end + 1;
+                if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+                    continue;
+                }
+                Json::Value item;
+                std::string errs;
+                if (!reader->parse(line.data(), line.data() + line.size(), &item, &errs)) {
+                    // keep the slot so results line up with the input; the item is reported as invalid
+                    item = Json::Value(Json::nullValue);
+                }
+                items.push_back(std::move(item));
+            }
+        } else {
+            auto json = req->getJsonObject();
+            if (!json || !json->isArray()) {
+                errorMsg = "Body must be a JSON array of products or NDJSON";
+                return false;
+            }
+            for (const auto &item: *json) {
+                items.push_back(item);
+            }
+        }
+
+        if (items.empty()) {
+            errorMsg = "No products in batch";
+            return false;
+        }
+        if (items.size() > kMaxBatchItems) {
+            errorMsg = fmt::format("Batch size exceeds {} products", kMaxBatchItems);
+            return false;
+        }
+        return true;
+    }
+
+    template<typename T>
+    void bindOptional(drogon::orm::internal::SqlBinder &binder, const std::optional<T> &value) {
+        if (value) {
+            binder << *value;
+        } else {
+            binder << nullptr;
+        }
+    }
+
+    // In-memory search index (custom_config.products.search_index), loaded at startup and kept current by
+    // the write handlers below
+    const Json::Value &searchIndexConfig() {
+        static const Json::Value config = app().getCustomConfig()["products"]["search_index"];
+        return config;
+    }
+
+    bool searchIndexEnabled() {
+        static const bool enabled = searchIndexConfig().get("enabled", false).asBool();
+        return enabled;
+    }
+
+    InvertedIndex &searchIndex() {
+        static InvertedIndex index;
+        return index;
+    }
+
+    std::atomic<bool> searchIndexReady{false};
+
+    // One thread for rebuilding the in-memory read structures, so neither the IO loops nor the database
+    // client's loop spend time on them
+    trantor::EventLoop *builderLoop() {
+        static auto thread = [] {
+            auto thread = std::make_unique<trantor::EventLoopThread>("catalog-builder");
+            thread->run();
+            return thread;
+        }();
+        return thread->getLoop();
+    }
+
+    // Typeahead (custom_config.products.suggest): a PrefixIndex over every title, ranked by how often each
+    // product was viewed or reserved on this instance. Rebuilt on its own thread when the catalog or the
+    // popularity changed, and swapped in whole; requests only ever read the published index.
+    struct Suggestions {
+        bool enabled = false;
+        size_t topK = 10;
+        double rebuildInterval = 5.0;
+        RcuSnapshot<PrefixIndex> index;
+        std::mutex popularityMutex;
+        std::unordered_map<uint32_t, uint64_t> popularity;
+        std::atomic<bool> titlesStale{true};     // a product was written: titles are read again
+        std::atomic<bool> popularityStale{false}; // only the ranking changed: the current titles are reused
+        std::atomic<bool> building{false};
+        std::atomic<uint64_t> builds{0};
+        std::atomic<uint64_t> lastBuildMicros{0};
+    };
+
+    Suggestions &suggestions() {
+        static Suggestions suggestions;
+        static std::once_flag configured;
+        std::call_once(configured, [] {
+            const auto &config = app().getCustomConfig()["products"]["suggest"];
+            suggestions.enabled = config.get("enabled", false).asBool();
+            suggestions.topK = std::clamp<Json::UInt64>(config.get("top_k", 10).asUInt64(), 1, 100);
+            suggestions.rebuildInterval = config.get("rebuild_interval_ms", 5000).asDouble() / 1000.0;
+        });
+        return suggestions;
+    }
+
+    // Immutable columnar copy of the whole catalog (custom_config.products.catalog_snapshot) behind the filtered
+    // listings and, with serve_reads, the plain product reads. Loaded whole at startup and every reload interval;
+    // in between, the products changed by this instance's writes or announced on the LISTEN channel
+    // (db/migrations/006_productcrud_notify.sql) are re-read from the primary and merged into a new copy on the
+    // builder thread. Readers get whole versions from the RcuSnapshot and never wait for a build.
+    struct CatalogSnapshot {
+        bool enabled = false;
+        bool serveReads = false;
+        double applyInterval = 0.2;
+        double reloadInterval = 300;
+        std::string listenChannel;
+        std::string listenConnection;
+        RcuSnapshot<CatalogColumns> columns;
+        std::mutex changedMutex;
+        std::vector<int32_t> changed; // ids waiting for the next apply
+        std::atomic<bool> reloadDue{true};
+        std::atomic<bool> building{false};
+        std::atomic<uint64_t> reloads{0};
+        std::atomic<uint64_t> applied{0};
+        std::atomic<uint64_t> notifications{0};
+        std::atomic<uint64_t> lastBuildMicros{0};
+        std::shared_ptr<DbListener> listener;
+    };
+
+    CatalogSnapshot &catalogSnapshot() {
+        static CatalogSnapshot snapshot;
+        static std::once_flag configured;
+        std::call_once(configured, [] {
+            const auto &config = app().getCustomConfig()["products"]["catalog_snapshot"];
+            snapshot.enabled = config.get("enabled", false).asBool();
+            snapshot.serveReads = config.get("serve_reads", false).asBool();
+            snapshot.applyInterval = config.get("apply_interval_ms", 200).asDouble() / 1000.0;
+            snapshot.reloadInterval = config.get("reload_interval_ms", 300000).asDouble() / 1000.0;
+            snapshot.listenChannel = config["listen"].get("channel", "productcrud_changes").asString();
+            snapshot.listenConnection = config["listen"].get("connection_info", "").asString();
+        });
+        return snapshot;
+    }
+
+    void catalogChanged(int id) {
+        auto &s = catalogSnapshot();
+        if (s.enabled) {
+            std::lock_guard<std::mutex> lock(s.changedMutex);
+            s.changed.push_back(id);
+        }
+    }
+
+    // Tell the other instances to evict the product (tools/invalidation_bus.h); the version is the row's
+    // version column, InvalidationBus::kUnversioned when the write may or may not have committed
+    void publishProductWrite(int id, int64_t version) {
+        InvalidationBus::instance().publish("product", std::to_string(id), version);
+    }
+
+    void countPopularity(int id, uint64_t weight) {
+        auto &s = suggestions();
+        if (!s.enabled) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(s.popularityMutex);
+            s.popularity[static_cast<uint32_t>(id)] += weight;
+        }
+        s.popularityStale.store(true, std::memory_order_relaxed);
+    }
+
+    // Every product write goes through these two, for the in-memory search structures
+    void catalogWritten(const Productcrud &product) {
+        if (searchIndexEnabled()) {
+            searchIndex().upsert(static_cast<uint32_t>(product.getValueOfId()), product.getValueOfTitle(),
+                                 product.getValueOfDescription());
+        }
+        suggestions().titlesStale.store(true, std::memory_order_relaxed);
+        catalogChanged(product.getValueOfId());
+        publishProductWrite(product.getValueOfId(), product.getValueOfVersion());
+    }
+
+    void catalogDeleted(int id) {
+        if (searchIndexEnabled()) {
+            searchIndex().remove(static_cast<uint32_t>(id));
+        }
+        auto &s = suggestions();
+        if (s.enabled) {
+            std::lock_guard<std::mutex> lock(s.popularityMutex);
+            s.popularity.erase(static_cast<uint32_t>(id));
+        }
+        s.titlesStale.store(true, std::memory_order_relaxed);
+        catalogChanged(id);
+        // ids are never reused, so nothing may be cached for this one any more
+        publishProductWrite(id, InvalidationBus::kDeleted);
+    }
+
+    // Send the answer to a successful product write with its read-your-writes token (tools/db_router.h)
+    void respondAfterProductWrite(const HttpResponsePtr &resp,
+                                  const std::function<void(const HttpResponsePtr &)> &callback,
+                                  std::optional<int> id = std::nullopt) {
+        DbRouter::instance().respondAfterWrite(resp, callback, [id]() {
+            if (id) {
+                CachedMapper<Productcrud>::invalidate(*id);
+            }
+            productsControllers::listingCache().bumpVersion();
+        });
+    }
+
+    // Apply a patch with a single UPDATE ... RETURNING round trip and answer with the fresh row;
+    // with expectedVersion set the row is only written if nobody changed it since the client read it
+    void applyProductPatch(const DbClientPtr &client, int id, const ProductPatch &patch,
+                           std::optional<int64_t> expectedVersion,
+                           const std::function<void(const HttpResponsePtr &)> &callback) {
+        auto send = [id, patch, expectedVersion](const DbClientPtr &connection, ResultCallback &&rcb,
+                                                ExceptionCallback &&ecb) {
+            auto binder =
+                *connection << (expectedVersion ? sqlForPatchingProductIfVersion() : sqlForPatchingProduct());
+            binder << id;
+            bindOptional(binder, patch.title);
+            bindOptional(binder, patch.description);
+            bindOptional(binder, patch.image);
+            bindOptional(binder, patch.price);
+            bindOptional(binder, patch.quantity);
+            if (expectedVersion) {
+                binder << *expectedVersion;
+            }
+            binder >> std::move(rcb);
+            binder >> std::move(ecb);
+            // the statement is sent when the binder goes out of scope
+        };
+        auto onUpdated = [client, callback, id, expectedVersion](const Result &r) {
+            if (r.empty()) {
+                if (expectedVersion) {
+                    respondToConditionalMiss(client, id, callback);
+                    return;
+                }
+                LOG_ERROR << "Product not found: id=" << id;
+                callback(createErrorResponse("Product not found", k404NotFound));
+                return;
+            }
+            CachedMapper<Productcrud>::invalidate(id);
+            productsControllers::listingCache().bumpVersion();
+            Productcrud product(r[0]);
+            catalogWritten(product);
+            Json::Value res;
+            res["status"] = "success";
+            res["message"] = fmt::format("Product with title '{}' updated successfully", product.getValueOfTitle());
+            res["data"] = product.toJson();
+            LOG_INFO << "Product updated successfully: id=" << id;
+            auto resp = HttpResponse::newHttpJsonResponse(res);
+            resp->setStatusCode(k200OK);
+            resp->addHeader("ETag", productEtag(product.getValueOfVersion()));
+            respondAfterProductWrite(resp, callback, id);
+        };
+        auto onFailed = [callback, id](const DrogonDbException &e) {
+            // a failed round trip (e.g. a timeout) may still have committed
+            CachedMapper<Productcrud>::invalidate(id);
+            productsControllers::listingCache().bumpVersion();
+            catalogChanged(id);
+            publishProductWrite(id, InvalidationBus::kUnversioned);
+            LOG_ERROR << "Database error: " << e.base().what();
+            callback(createErrorResponse(fmt::format("Database error: {}", e.base().what()),
+                                         k500InternalServerError));
+        };
+        DbRouter::instance().onPrimary(std::move(send), std::move(onUpdated), std::move(onFailed));
+    }
+
+    void respondProductCreated(const Productcrud &p, const std::function<void(const HttpResponsePtr &)> &callback) {
+        productsControllers::listingCache().bumpVersion();
+        catalogWritten(p);
+        Json::Value res;
+        res["status"] = "success";
+        res["message"] = fmt::format("Product with title '{}' created successfully", p.getValueOfTitle());
+        Json::Value data;
+        data["id"] = p.getValueOfId();
+        data["title"] = p.getValueOfTitle();
+        data["description"] = p.getValueOfDescription();
+        data["price"] = p.getValueOfPrice();
+        data["quantity"] = p.getValueOfQuantity();
+        data["image"] = p.getValueOfImage();
+        data["version"] = static_cast<Json::Int64>(p.getValueOfVersion());
+        res["data"] = data;
+        LOG_INFO << "Product created successfully: id=" << p.getValueOfId();
+        auto resp = HttpResponse::newHttpJsonResponse(res);
+        resp->setStatusCode(k201Created);
+        resp->addHeader("ETag", productEtag(p.getValueOfVersion()));
+        respondAfterProductWrite(resp, callback);
+    }
+
+    void respondProductInsertFailed(const std::string &error,
+                                    const std::function<void(const HttpResponsePtr &)> &callback) {
+        LOG_ERROR << "Database error: " << error;
+        callback(createErrorResponse(fmt::format("Database error: {}", error), k500InternalServerError));
+    }
+
+    // One createProducts row waiting for its write-behind batch
+    struct ProductInsert {
+        std::string title;
+        std::string description;
+        std::string image;
+        double price = 0.0;
+        int32_t quantity = 0;
+    };
+
+    struct ProductInsertOutcome {
+        std::optional<Productcrud> product;
+        std::string error; // set when the batch failed
+    };
+
+    using ProductInserts = MicroBatcher<ProductInsert, ProductInsertOutcome>;
+
+    // The rows of a batch the server rejected, each through the single-row insert, so that only the callers whose
+    // own row is bad get an error
+    void insertProductsOneByOne(const std::vector<ProductInsert> &items, const ProductInserts::Resolve &resolve) {
+        struct Pending {
+            std::mutex mutex;
+            std::vector<ProductInsertOutcome> outcomes;
+            size_t remaining = 0;
+        };
+        auto pending = std::make_shared<Pending>();
+        pending->outcomes.resize(items.size());
+        pending->remaining = items.size();
+        auto settle = [pending, resolve](size_t i, ProductInsertOutcome outcome) {
+            bool last;
+            {
+                std::lock_guard<std::mutex> lock(pending->mutex);
+                pending->outcomes[i] = std::move(outcome);
+                last = --pending->remaining == 0;
+            }
+            if (last) {
+                resolve(pending->outcomes);
+            }
+        };
+        for (size_t i = 0; i < items.size(); ++i) {
+            DbRouter::instance().onPrimary(
+                [item = items[i]](const DbClientPtr &connection, ResultCallback &&rcb, ExceptionCallback &&ecb) {
+                    connection->execSqlAsync(sqlForInsertingProduct(), std::move(rcb), std::move(ecb), item.title,
+                                             item.description, item.image, item.price, item.quantity);
+                },
+                [settle, i](const Result &r) { settle(i, {Productcrud(r[0]), {}}); },
+                [settle, i](const DrogonDbException &e) { settle(i, {std::nullopt, e.base().what()}); });
+        }
+    }
+
+    // A whole batch is one insert_batch statement, the same multi-row insert /api/products/batch uses
+    void flushProductInserts(std::vector<ProductInsert> &&items, ProductInserts::Resolve resolve) {
+        std::vector<std::string> titles, descriptions, images, prices, quantities;
+        for (const auto &item: items) {
+            titles.push_back(item.title);
+            descriptions.push_back(item.description);
+            images.push_back(item.image);
+            prices.push_back(fmt::format("{}", item.price));
+            quantities.push_back(std::to_string(item.quantity));
+        }
+        auto count = items.size();
+        auto batch = std::make_shared<const std::vector<ProductInsert>>(std::move(items));
+        DbRouter::instance().onPrimary(
+            [titles = to_pg_array_literal(titles), descriptions = to_pg_array_literal(descriptions),
+             images = to_pg_array_literal(images), prices = to_pg_array_literal(prices),
+             quantities = to_pg_array_literal(quantities)](const DbClientPtr &connection, ResultCallback &&rcb,
+                                                            ExceptionCallback &&ecb) {
+                connection->execSqlAsync(sqlForInsertingProductBatch(), std::move(rcb), std::move(ecb), titles,
+                                         descriptions, images, prices, quantities);
+            },
+            [resolve, count](const Result &r) {
+                // ids come from one sequence in insertion order, so sorting by id restores the batch order
+                std::vector<ProductInsertOutcome> outcomes;
+                outcomes.reserve(count);
+                for (const auto &row: r) {
+                    outcomes.push_back({Productcrud(row), {}});
+                }
+                std::sort(outcomes.begin(), outcomes.end(), [](const auto &a, const auto &b) {
+                    return a.product->getValueOfId() < b.product->getValueOfId();
+                });
+                outcomes.resize(count, {std::nullopt, "Row missing from batch insert"});
+                LOG_DEBUG << "Inserted a batch of " << r.size() << " products";
+                resolve(outcomes);
+            },
+            [resolve, count, batch](const DrogonDbException &e) {
+                // one bad row fails the statement and nothing is written; anything else (a timeout, a lost
+                // connection) may have committed the batch, so it is not sent again
+                if (count > 1 && dynamic_cast<const SqlError *>(&e)) {
+                    LOG_WARN << "Batch insert of " << count << " products failed, inserting them one by one: "
+                             << e.base().what();
+                    insertProductsOneByOne(*batch, resolve);
+                    return;
+                }
+                resolve(std::vector<ProductInsertOutcome>(count, {std::nullopt, e.base().what()}));
+            });
+    }
+
+    // Opt-in (custom_config.products.insert_batching): concurrent createProducts calls share one insert
+    const Json::Value &insertBatchingConfig() {
+        static const Json::Value config = app().getCustomConfig()["products"]["insert_batching"];
+        return config;
+    }
+
+    bool insertBatchingEnabled() {
+        static const bool enabled = insertBatchingConfig().get("enabled", false).asBool();
+        return enabled;
+    }
+
+    ProductInserts &productInserts() {
+        const auto &config = insertBatchingConfig();
+        static ProductInserts inserts(
+            config.get("max_rows", 100).asUInt64(),
+            std::chrono::microseconds(static_cast<int64_t>(config.get("window_ms", 2.0).asDouble() * 1000)),
+            flushProductInserts,
+            [](std::chrono::microseconds delay, std::function<void()> fire) {
+                app().getLoop()->runAfter(std::chrono::duration<double>(delay), std::move(fire));
+            });
+        return inserts;
+    }
+
+    // Products whose stock is leased from the row and sold from memory (custom_config.products.hot_skus)
+    struct HotStock {
+        std::unordered_map<int, std::unique_ptr<StockCounter>> counters; // fixed after startup, read without a lock
+        double transferInterval = 0.1;
+    };
+
+    HotStock &hotStock() {
+        static HotStock stock = [] {
+            HotStock stock;
+            const auto &config = app().getCustomConfig()["products"]["hot_skus"];
+            auto block = config.get("lease_block", 100).asInt64();
+            for (const auto &id: config["ids"]) {
+                stock.counters.emplace(id.asInt(), std::make_unique<StockCounter>(block));
+            }
+            stock.transferInterval = config.get("transfer_interval_ms", 100).asDouble() / 1000.0;
+            return stock;
+        }();
+        return stock;
+    }
+
+    StockCounter *hotCounter(int id) {
+        auto &counters = hotStock().counters;
+        auto it = counters.find(id);
+        return it == counters.end() ? nullptr : it->second.get();
+    }
+
+    // The row's quantity moved; version 0 when the write may or may not have committed
+    void hotStockWritten(int id, int64_t version) {
+        CachedMapper<Productcrud>::invalidate(id);
+        productsControllers::listingCache().bumpVersion();
+        catalogChanged(id);
+        publishProductWrite(id, version);
+    }
+
+    // No row came back from a lease: sold out, unless the product does not exist, which leaves the counter unready
+    // so that reserve/release keep answering from the database
+    void settleEmptyLease(int id, StockCounter &counter) {
+        if (counter.ready()) {
+            counter.transferred(0);
+            return;
+        }
+        DbRouter::instance().writer()->execSqlAsync(
+            sqlForProductQuantity(),
+            [id, &counter](const Result &r) {
+                if (r.empty()) {
+                    LOG_ERROR << "Hot SKU " << id << " does not exist";
+                    counter.transferFailed();
+                    return;
+                }
+                counter.transferred(0);
+            },
+            [id, &counter](const DrogonDbException &e) {
+                LOG_ERROR << "Reading stock of hot SKU " << id << " failed: " << e.base().what();
+                counter.transferFailed();
+            },
+            id);
+    }
+
+    void leaseHotStock(int id, StockCounter &counter, int64_t units) {
+        DbRouter::instance().onPrimary(
+            [id, units](const DbClientPtr &connection, ResultCallback &&rcb, ExceptionCallback &&ecb) {
+                connection->execSqlAsync(sqlForLeasingStock(), std::move(rcb), std::move(ecb), id,
+                                         static_cast<int32_t>(units));
+            },
+            [id, &counter](const Result &r) {
+                if (r.empty()) {
+                    settleEmptyLease(id, counter);
+                    return;
+                }
+                hotStockWritten(id, r[0]["version"].as<int64_t>());
+                counter.transferred(r[0]["leased"].as<int64_t>());
+            },
+            [id, &counter, units](const DrogonDbException &e) {
+                // whatever the row gave is not sold: nothing is sold twice, but it may have left the row for good
+                LOG_ERROR << "Leasing stock of hot SKU " << id << " failed: " << e.base().what() << "; up to "
+                          << units << " unit(s) may have left the row without reaching this instance";
+                hotStockWritten(id, InvalidationBus::kUnversioned);
+                counter.transferFailed();
+            });
+    }
+
+    void returnHotStock(int id, StockCounter &counter, int64_t units) {
+        DbRouter::instance().onPrimary(
+            [id, units](const DbClientPtr &connection, ResultCallback &&rcb, ExceptionCallback &&ecb) {
+                connection->execSqlAsync(sqlForAdjustingStock(), std::move(rcb), std::move(ecb), id,
+                                         static_cast<int32_t>(units));
+            },
+            [id, &counter, units](const Result &r) {
+                if (r.empty()) {
+                    LOG_ERROR << "Hot SKU " << id << " was deleted, dropping " << units << " returned unit(s)";
+                } else {
+                    hotStockWritten(id, r[0]["version"].as<int64_t>());
+                }
+                counter.transferred(0);
+            },
+            [id, &counter, units](const DrogonDbException &e) {
+                LOG_ERROR << "Returning stock of hot SKU " << id << " failed: " << e.base().what() << "; up to "
+                          << units << " unit(s) may not have reached the row";
+                hotStockWritten(id, InvalidationBus::kUnversioned);
+                counter.transferFailed();
+            });
+    }
+
+    // Tops each lease up from the row, or hands the surplus back, one transfer per counter at a time
+    void transferHotStock() {
+        for (auto &[id, counter]: hotStock().counters) {
+            auto units = counter->beginTransfer();
+            if (!units) {
+                continue;
+            }
+            if (*units > 0) {
+                leaseHotStock(id, *counter, *units);
+            } else {
+                returnHotStock(id, *counter, -*units);
+            }
+        }
+    }
+
+    // Quantity of a reserve/release body, 1 when there is no body
+    bool parseStockQuantity(const HttpRequestPtr &req, int32_t &quantity, std::string &errorMsg) {
+        quantity = 1;
+        if (req->getBody().empty()) {
+            return true;
+        }
+        auto json = req->getJsonObject();
+        if (!json || !json->isObject()) {
+            errorMsg = "Body must be a JSON object";
+            return false;
+        }
+        if (!json->isMember("quantity")) {
+            return true;
+        }
+        const auto &value = (*json)["quantity"];
+        if (!value.isInt() || value.asInt() < 1 || value.asInt() > 1000000) {
+            errorMsg = "quantity must be an integer between 1 and 1000000";
+            return false;
+        }
+        quantity = value.asInt();
+        return true;
+    }
+
+    HttpResponsePtr createStockResponse(int id, const char *action, int32_t quantity, int64_t remaining) {
+        Json::Value res;
+        res["status"] = "success";
+        res["data"]["id"] = id;
+        res["data"][action] = quantity;
+        res["data"]["quantity"] = static_cast<Json::Int64>(remaining);
+        auto resp = HttpResponse::newHttpJsonResponse(res);
+        resp->setStatusCode(k200OK);
+        return resp;
+    }
+
+    HttpResponsePtr createInsufficientStockResponse(int64_t available) {
+        Json::Value res;
+        res["status"] = "error";
+        res["message"] = "Insufficient stock";
+        res["available"] = static_cast<Json::Int64>(available);
+        auto resp = HttpResponse::newHttpJsonResponse(res);
+        resp->setStatusCode(k409Conflict);
+        return resp;
+    }
+
+    // reserve: take quantity if that much is in stock; otherwise put quantity back
+    void changeStock(const HttpRequestPtr &req, const std::function<void(const HttpResponsePtr &)> &callback,
+                     int id, bool reserve) {
+        int32_t quantity = 0;
+        std::string errorMsg;
+        if (!parseStockQuantity(req, quantity, errorMsg)) {
+            callback(createErrorResponse(errorMsg, k400BadRequest));
+            return;
+        }
+        const char *action = reserve ? "reserved" : "released";
+
+        // hot SKUs are answered from this instance's lease
+        if (auto *counter = hotCounter(id); counter && counter->ready()) {
+            if (!reserve) {
+                callback(createStockResponse(id, action, quantity, counter->release(quantity)));
+            } else if (auto remaining = counter->reserve(quantity)) {
+                countPopularity(id, quantity);
+                callback(createStockResponse(id, action, quantity, *remaining));
+            } else {
+                callback(createInsufficientStockResponse(counter->available()));
+            }
+            return;
+        }
+
+        DbRouter::instance().onPrimary(
+            [id, quantity, reserve](const DbClientPtr &connection, ResultCallback &&rcb, ExceptionCallback &&ecb) {
+                connection->execSqlAsync(reserve ? sqlForReservingStock() : sqlForAdjustingStock(), std::move(rcb),
+                                         std::move(ecb), id, quantity);
+            },
+            [callback, id, quantity, reserve, action](const Result &r) {
+                if (!r.empty()) {
+                    CachedMapper<Productcrud>::invalidate(id);
+                    productsControllers::listingCache().bumpVersion();
+                    catalogChanged(id);
+                    publishProductWrite(id, r[0]["version"].as<int64_t>());
+                    LOG_INFO << "Product " << id << ": " << action << " " << quantity;
+                    if (reserve) {
+                        countPopularity(id, quantity);
+                    }
+                    auto remaining = r[0]["quantity"].as<int64_t>();
+                    respondAfterProductWrite(createStockResponse(id, action, quantity, remaining), callback, id);
+                    return;
+                }
+                // nothing updated: the product is missing, or (reserve) has too little stock
+                DbRouter::instance().writer()->execSqlAsync(
+                    sqlForProductQuantity(),
+                    [callback, id, reserve](const Result &r) {
+                        if (r.empty() || !reserve) {
+                            LOG_ERROR << "Product not found: id=" << id;
+                            callback(createErrorResponse("Product not found", k404NotFound));
+                            return;
+                        }
+                        callback(createInsufficientStockResponse(r[0]["quantity"].as<int64_t>()));
+                    },
+                    [callback](const DrogonDbException &e) {
+                        LOG_ERROR << "Database error: " << e.base().what();
+                        callback(createErrorResponse(fmt::format("Database error: {}", e.base().what()),
+                                                     k500InternalServerError));
+                    },
+                    id);
+            },
+            [callback, id](const DrogonDbException &e) {
+                // a failed round trip (e.g. a timeout) may still have committed
+                CachedMapper<Productcrud>::invalidate(id);
+                productsControllers::listingCache().bumpVersion();
+                catalogChanged(id);
+                publishProductWrite(id, InvalidationBus::kUnversioned);
+                LOG_ERROR << "Database error: " << e.base().what();
+                callback(createErrorResponse(fmt::format("Database error: {}", e.base().what()),
+                                             k500InternalServerError));
+            });
+    }
+
+    const std::string &sqlForIndexBatch() {
+        static const std::string &sql = productStatement("products.index_batch").sql;
+        return sql;
+    }
+
+    // Bulk load of the search index, one keyset batch of products at a time
+    constexpr int64_t kIndexBatchSize = 5000;
+
+    // From the primary: a lagging replica could return a product whose delete was already applied to the index
+    void loadSearchIndex(int32_t afterId) {
+        DbRouter::instance().writer()->execSqlAsync(
+            sqlForIndexBatch(),
+            [](const Result &r) {
+                auto &index = searchIndex();
+                for (const auto &row: r) {
+                    // a product written since the load started is already indexed with its newer text
+                    index.insertIfAbsent(row["id"].as<uint32_t>(), row["title"].as<std::string>(),
+                                         row["description"].as<std::string>());
+                }
+                if (static_cast<int64_t>(r.size()) == kIndexBatchSize) {
+                    loadSearchIndex(r[r.size() - 1]["id"].as<int32_t>());
+                    return;
+                }
+                index.endLoad();
+                searchIndexReady.store(true, std::memory_order_release);
+                LOG_INFO << "Search index loaded: " << index.documents() << " products, " << index.terms()
+                         << " terms";
+            },
+            [afterId](const DrogonDbException &e) {
+                LOG_ERROR << "Loading the search index failed after id " << afterId << ": " << e.base().what();
+                app().getLoop()->runAfter(5.0, [afterId]() { loadSearchIndex(afterId); });
+            },
+            afterId, kIndexBatchSize);
+    }
+
+    const std::string &sqlForProductTitles() {
+        static const std::string &sql = productStatement("products.titles").sql;
+        return sql;
+    }
+
+    // Runs on the builder thread: rank the titles by the current popularity and publish the new index
+    void buildSuggestions(std::vector<PrefixIndex::Entry> entries) {
+        auto &s = suggestions();
+        auto started = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(s.popularityMutex);
+            for (auto &entry: entries) {
+                auto it = s.popularity.find(entry.id);
+                entry.score = it == s.popularity.end() ? 0 : it->second;
+            }
+        }
+        s.index.publish(std::make_shared<const PrefixIndex>(std::move(entries), s.topK));
+        s.lastBuildMicros.store(std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - started).count(),
+                                std::memory_order_relaxed);
+        s.builds.fetch_add(1, std::memory_order_relaxed);
+        s.building.store(false, std::memory_order_release);
+    }
+
+    // Builds the next PrefixIndex on the builder thread; titles are read again only after a product write, and
+    // from the primary, since a lagging replica would hand back the titles from before the write that cleared
+    // titlesStale and nothing would mark them stale again
+    void rebuildSuggestions() {
+        auto &s = suggestions();
+        bool titles = s.titlesStale.load(std::memory_order_relaxed);
+        if ((!titles && !s.popularityStale.load(std::memory_order_relaxed)) || s.building.exchange(true)) {
+            return;
+        }
+        // anything that changes from here on is picked up by the next rebuild
+        s.titlesStale.store(false, std::memory_order_relaxed);
+        s.popularityStale.store(false, std::memory_order_relaxed);
+        auto current = s.index.load();
+        if (!titles && current) {
+            builderLoop()->queueInLoop([current]() { buildSuggestions(current->entries()); });
+            return;
+        }
+        DbRouter::instance().writer()->execSqlAsync(
+            sqlForProductTitles(),
+            [](const Result &r) {
+                builderLoop()->queueInLoop([r]() {
+                    std::vector<PrefixIndex::Entry> entries;
+                    entries.reserve(r.size());
+                    for (const auto &row: r) {
+                        entries.push_back({row["id"].as<uint32_t>(), row["title"].as<std::string>(), 0});
+                    }
+                    buildSuggestions(std::move(entries));
+                });
+            },
+            [](const DrogonDbException &e) {
+                LOG_ERROR << "Loading product titles for suggestions failed: " << e.base().what();
+                auto &s = suggestions();
+                s.titlesStale.store(true, std::memory_order_relaxed);
+                s.building.store(false, std::memory_order_release);
+            });
+    }
+
+    const std::string &sqlForCatalog() {
+        static const std::string &sql = productStatement("products.catalog").sql;
+        return sql;
+    }
+
+    template<typename T>
+    std::optional<std::string_view> optionalText(const std::shared_ptr<T> &value) {
+        return value ? std::optional<std::string_view>(*value) : std::nullopt;
+    }
+
+    void appendProduct(CatalogColumns &columns, const Productcrud &product) {
+        columns.append(product.getValueOfId(),
+                       product.getPrice() ? product.getValueOfPrice() : std::numeric_limits<double>::quiet_NaN(),
+                       product.getValueOfQuantity(), product.getValueOfCreatedAt().microSecondsSinceEpoch(),
+                       product.getValueOfVersion(), optionalText(product.getTitle()),
+                       optionalText(product.getDescription()), optionalText(product.getImage()));
+    }
+
+    // Runs on the builder thread
+    void publishCatalog(CatalogColumns columns, std::chrono::steady_clock::time_point started) {
+        auto &s = catalogSnapshot();
+        s.columns.publish(std::make_shared<const CatalogColumns>(std::move(columns)));
+        s.lastBuildMicros.store(std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - started).count(),
+                                std::memory_order_relaxed);
+        s.building.store(false, std::memory_order_release);
+    }
+
+    // Whole catalog from the primary, so a reload never goes back behind changes already merged in
+    void reloadCatalogSnapshot() {
+        DbRouter::instance().writer()->execSqlAsync(
+            sqlForCatalog(),
+            [](const Result &r) {
+                builderLoop()->queueInLoop([r]() {
+                    auto started = std::chrono::steady_clock::now();
+                    CatalogColumns columns;
+                    columns.reserve(r.size());
+                    for (const auto &row: r) {
+                        appendProduct(columns, Productcrud(row));
+                    }
+                    catalogSnapshot().reloads.fetch_add(1, std::memory_order_relaxed);
+                    publishCatalog(std::move(columns), started);
+                });
+            },
+            [](const DrogonDbException &e) {
+                LOG_ERROR << "Loading the catalog snapshot failed: " << e.base().what();
+                auto &s = catalogSnapshot();
+                s.reloadDue.store(true, std::memory_order_relaxed);
+                s.building.store(false, std::memory_order_release);
+            });
+    }
+
+    // Re-read the changed products from the primary and merge them into a new copy; an id that no longer
+    // exists is a delete. One build at a time, so copies are published in the order their rows were read.
+    void applyCatalogChanges(std::vector<int32_t> ids) {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        std::vector<std::string> literals;
+        literals.reserve(ids.size());
+        for (auto id: ids) {
+            literals.push_back(std::to_string(id));
+        }
+        DbRouter::instance().writer()->execSqlAsync(
+            sqlForProductsByIds(ProductFields{}),
+            [ids](const Result &r) {
+                builderLoop()->queueInLoop([ids, r]() {
+                    auto &s = catalogSnapshot();
+                    auto started = std::chrono::steady_clock::now();
+                    std::vector<Productcrud> rows;
+                    rows.reserve(r.size());
+                    for (const auto &row: r) {
+                        rows.emplace_back(row);
+                    }
+                    std::sort(rows.begin(), rows.end(), [](const Productcrud &a, const Productcrud &b) {
+                        return a.getValueOfId() < b.getValueOfId();
+                    });
+                    CatalogColumns changes;
+                    changes.reserve(rows.size());
+                    std::vector<int32_t> removed;
+                    auto row = rows.begin();
+                    for (auto id: ids) {
+                        if (row != rows.end() && row->getValueOfId() == id) {
+                            appendProduct(changes, *row++);
+                        } else {
+                            removed.push_back(id);
+                        }
+                    }
+                    s.applied.fetch_add(ids.size(), std::memory_order_relaxed);
+                    publishCatalog(CatalogColumns::merged(*s.columns.load(), changes, removed), started);
+                });
+            },
+            [ids](const DrogonDbException &e) {
+                LOG_ERROR << "Applying catalog changes failed: " << e.base().what();
+                auto &s = catalogSnapshot();
+                {
+                    std::lock_guard<std::mutex> lock(s.changedMutex);
+                    s.changed.insert(s.changed.end(), ids.begin(), ids.end());
+                }
+                s.building.store(false, std::memory_order_release);
+            },
+            to_pg_array_literal(literals));
+    }
+
+    void refreshCatalogSnapshot() {
+        auto &s = catalogSnapshot();
+        if (s.building.exchange(true)) {
+            return;
+        }
+        if (s.reloadDue.exchange(false) || !s.columns.load()) {
+            reloadCatalogSnapshot();
+            return;
+        }
+        std::vector<int32_t> ids;
+        {
+            std::lock_guard<std::mutex> lock(s.changedMutex);
+            ids.swap(s.changed);
+        }
+        if (ids.empty()) {
+            s.building.store(false, std::memory_order_release);
+            return;
+        }
+        applyCatalogChanges(std::move(ids));
+    }
+
+    // Products another instance wrote, waiting to be re-read from the primary into the search index. One read
+    // at a time, so an older read never lands on top of a newer one.
+    struct RemoteIndexUpdates {
+        std::mutex mutex;
+        std::vector<int32_t> ids;
+        bool reading = false;
+    };
+
+    RemoteIndexUpdates &remoteIndexUpdates() {
+        static RemoteIndexUpdates updates;
+        return updates;
+    }
+
+    // Like applyCatalogChanges: a row that comes back is re-indexed, an id without one was deleted
+    void readRemoteIndexUpdates() {
+        auto &updates = remoteIndexUpdates();
+        std::vector<int32_t> ids;
+        {
+            std::lock_guard<std::mutex> lock(updates.mutex);
+            if (updates.ids.empty()) {
+                updates.reading = false;
+                return;
+            }
+            ids.swap(updates.ids);
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        std::vector<std::string> literals;
+        literals.reserve(ids.size());
+        for (auto id: ids) {
+            literals.push_back(std::to_string(id));
+        }
+        DbRouter::instance().writer()->execSqlAsync(
+            sqlForProductsByIds(ProductFields{}),
+            [ids](const Result &r) {
+                auto &index = searchIndex();
+                std::unordered_set<int32_t> found;
+                for (const auto &row: r) {
+                    Productcrud product(row);
+                    found.insert(product.getValueOfId());
+                    index.upsert(static_cast<uint32_t>(product.getValueOfId()), product.getValueOfTitle(),
+                                 product.getValueOfDescription());
+                }
+                for (auto id: ids) {
+                    if (!found.count(id)) {
+                        index.remove(static_cast<uint32_t>(id));
+                    }
+                }
+                readRemoteIndexUpdates();
+            },
+            [ids](const DrogonDbException &e) {
+                LOG_ERROR << "Reading products written by another instance into the search index failed: "
+                          << e.base().what();
+                auto &updates = remoteIndexUpdates();
+                {
+                    std::lock_guard<std::mutex> lock(updates.mutex);
+                    updates.ids.insert(updates.ids.end(), ids.begin(), ids.end());
+                }
+                app().getLoop()->runAfter(1.0, []() { readRemoteIndexUpdates(); });
+            },
+            to_pg_array_literal(literals));
+    }
+
+    void remoteIndexUpdate(int32_t id) {
+        auto &updates = remoteIndexUpdates();
+        {
+            std::lock_guard<std::mutex> lock(updates.mutex);
+            updates.ids.push_back(id);
+            if (updates.reading) {
+                return;
+            }
+            updates.reading = true;
+        }
+        readRemoteIndexUpdates();
+    }
+
+    // ?min_price=&max_price=&in_stock=&sort= of getAllProducts; filtered is set when the listing has to come
+    // from the catalog snapshot instead of the keyset query
+    bool parseListingFilter(const HttpRequestPtr &req, CatalogColumns::Filter &filter, CatalogColumns::Order &order,
+                            bool &filtered, std::string &errorMsg) {
+        for (auto [name, bound]: {std::pair{"min_price", &filter.minPrice}, std::pair{"max_price", &filter.maxPrice}}) {
+            const auto &param = req->getParameter(name);
+            if (param.empty()) {
+                continue;
+            }
+            double value = 0;
+            auto [ptr, ec] = std::from_chars(param.data(), param.data() + param.size(), value);
+            if (ec != std::errc() || ptr != param.data() + param.size() || !std::isfinite(value)) {
+                errorMsg = fmt::format("{} must be a number", name);
+                return false;
+            }
+            *bound = value;
+        }
+        if (filter.minPrice && filter.maxPrice && *filter.minPrice > *filter.maxPrice) {
+            errorMsg = "min_price must not exceed max_price";
+            return false;
+        }
+        const auto &inStock = req->getParameter("in_stock");
+        filter.inStock = inStock == "true" || inStock == "1";
+
+        const auto &sort = req->getParameter("sort");
+        if (sort.empty() || sort == "newest") {
+            order = CatalogColumns::Order::Newest;
+        } else if (sort == "price") {
+            order = CatalogColumns::Order::PriceAsc;
+        } else if (sort == "-price") {
+            order = CatalogColumns::Order::PriceDesc;
+        } else {
+            errorMsg = "sort must be newest, price or -price";
+            return false;
+        }
+        filtered = filter.minPrice || filter.maxPrice || filter.inStock || order != CatalogColumns::Order::Newest;
+        return true;
+    }
+
+    // A snapshot row as the model would serialise it
+    Json::Value catalogRowJson(const CatalogColumns &columns, uint32_t row) {
+        Productcrud product;
+        product.setId(columns.id(row));
+        if (auto title = columns.title(row)) {
+            product.setTitle(std::string(*title));
+        }
+        if (auto description = columns.description(row)) {
+            product.setDescription(std::string(*description));
+        }
+        if (auto image = columns.image(row)) {
+            product.setImage(std::string(*image));
+        }
+        if (!std::isnan(columns.price(row))) {
+            product.setPrice(columns.price(row));
+        }
+        product.setQuantity(columns.quantity(row));
+        product.setCreatedAt(trantor::Date(columns.createdAt(row)));
+        product.setVersion(columns.version(row));
+        return product.toJson();
+    }
+
+    // Copy the selected fields out of a whole serialised row
+    Json::Value projectJson(const Json::Value &row, const ProductFields &fields) {
+        if (fields.all()) {
+            return row;
+        }
+        Json::Value ret;
+        for (const auto &column: fields.columns) {
+            auto name = column.substr(1, column.size() - 2);
+            ret[name] = row[name];
+        }
+        return ret;
+    }
+
+    // The snapshot for a plain read, unless reads are not served from it or the request carries a
+    // read-your-writes token (the snapshot may not have merged that write yet)
+    std::shared_ptr<const CatalogColumns> catalogForRead(const HttpRequestPtr &req) {
+        auto &snapshot = catalogSnapshot();
+        if (!snapshot.serveReads || DbRouter::instance().requestToken(req) != 0) {
+            return nullptr;
+        }
+        return snapshot.columns.load();
+    }
+
+    // A filtered or price-sorted listing page, straight from the catalog snapshot
+    void respondWithCatalogPage(const CatalogColumns::Filter &filter, CatalogColumns::Order order, size_t limit,
+                                std::optional<CatalogColumns::Key> after, const ProductFields &fields,
+                                const std::function<void(const HttpResponsePtr &)> &callback) {
+        auto &snapshot = catalogSnapshot();
+        if (!snapshot.enabled) {
+            callback(createErrorResponse("Filtering and sorting need custom_config.products.catalog_snapshot",
+                                         k400BadRequest));
+            return;
+        }
+        auto columns = snapshot.columns.load();
+        if (!columns) {
+            callback(createErrorResponse("The catalog snapshot is not loaded yet", k503ServiceUnavailable));
+            return;
+        }
+
+        // one extra row tells whether another page exists
+        auto rows = columns->top(filter, order, limit + 1, after);
+        Json::Value data(Json::arrayValue);
+        for (size_t i = 0; i < std::min(rows.size(), limit); ++i) {
+            data.append(projectJson(catalogRowJson(*columns, rows[i]), fields));
+        }
+        Json::Value res;
+        res["status"] = "success";
+        res["message"] = "List of products fetched successfully";
+        res["data"] = data;
+        if (rows.size() > limit) {
+            auto key = columns->key(rows[limit - 1], order);
+            res["next_cursor"] = encode_sort_cursor({key.value, key.id});
+        } else {
+            res["next_cursor"] = Json::Value();
+        }
+        auto resp = HttpResponse::newHttpJsonResponse(res);
+        resp->setStatusCode(k200OK);
+        callback(resp);
+    }
+
+    // Answer a search from the in-memory index: rows come from the product cache, and the ones it misses
+    // from a single multi-get
+    void respondWithIndexHits(const DbClientPtr &client, std::vector<InvertedIndex::Hit> hits, size_t limit,
+                              const ProductFields &fields,
+                              const std::function<void(const HttpResponsePtr &)> &callback) {
+        Json::Value nextCursor;
+        if (hits.size() > limit) {
+            hits.resize(limit);
+            nextCursor = encode_search_cursor({hits.back().score, static_cast<int32_t>(hits.back().id)});
+        }
+        auto rows = std::make_shared<std::vector<Json::Value>>(hits.size());
+        std::vector<std::string> missing;
+        for (size_t i = 0; i < hits.size(); ++i) {
+            if (auto product = CachedMapper<Productcrud>::findCached(static_cast<int>(hits[i].id))) {
+                (*rows)[i] = projectJson(product->toJson(), fields);
+            } else {
+                missing.push_back(std::to_string(hits[i].id));
+            }
+        }
+
+        auto respond = [callback, hits, rows, nextCursor]() {
+            Json::Value data(Json::arrayValue);
+            for (size_t i = 0; i < hits.size(); ++i) {
+                // null: deleted between the index lookup and the fetch
+                if ((*rows)[i].isNull()) {
+                    continue;
+                }
+                (*rows)[i]["rank"] = hits[i].score;
+                data.append((*rows)[i]);
+            }
+            Json::Value res;
+            res["status"] = "success";
+            res["data"] = data;
+            res["next_cursor"] = nextCursor;
+            auto resp = HttpResponse::newHttpJsonResponse(res);
+            resp->setStatusCode(k200OK);
+            callback(resp);
+        };
+        if (missing.empty()) {
+            respond();
+            return;
+        }
+        client->execSqlAsync(
+            sqlForProductsByIds(fields),
+            [respond, hits, rows, fields](const Result &r) {
+                std::unordered_map<uint32_t, size_t> position;
+                for (size_t i = 0; i < hits.size(); ++i) {
+                    position.emplace(hits[i].id, i);
+                }
+                for (const auto &row: r) {
+                    auto it = position.find(row["id"].as<uint32_t>());
+                    if (it != position.end()) {
+                        (*rows)[it->second] = fields.toJson(row);
+                    }
+                }
+                respond();
+            },
+            [callback](const DrogonDbException &e) {
+                LOG_ERROR << "Database error: " << e.base().what();
+                callback(createErrorResponse(fmt::format("Database error: {}", e.base().what()),
+                                             k500InternalServerError));
+            },
+            to_pg_array_literal(missing));
+    }
 }
 
 void productsControllers::createProducts(const HttpRequestPtr &req,
@@ -129,7 +2000,7 @@ void productsControllers::createProducts(const HttpRequestPtr &req,
 
     try {
         // Get database client
-        auto client = app().getDbClient();
+        auto client = DbRouter::instance().writer();
         if (!client) {
             LOG_ERROR << "Database client not initialized";
             callback(createErrorResponse("Database client not initialized", k500InternalServerError));
@@ -234,244 +2105,696 @@ void productsControllers::createProducts(const HttpRequestPtr &req,
 
         // Insert into database
         LOG_DEBUG << "Inserting product into database: title=" << title;
-        Mapper<Productcrud> mapper(client);
-        Productcrud product;
-        product.setTitle(title);
-        product.setDescription(description);
-        product.setPrice(price);
-        product.setQuantity(quantity);
-        product.setImage(imagePath);
+        if (insertBatchingEnabled()) {
+            productInserts().add(ProductInsert{title, description, imagePath, price, static_cast<int32_t>(quantity)},
+                                 [callback](const ProductInsertOutcome &outcome) {
+                                     if (outcome.product) {
+                                         respondProductCreated(*outcome.product, callback);
+                                     } else {
+                                         respondProductInsertFailed(outcome.error, callback);
+                                     }
+                                 });
+            return;
+        }
+        DbRouter::instance().onPrimary(
+            [title, description, imagePath, price, quantity](const DbClientPtr &connection, ResultCallback &&rcb,
+                                                              ExceptionCallback &&ecb) {
+                connection->execSqlAsync(sqlForInsertingProduct(), std::move(rcb), std::move(ecb), title,
+                                         description, imagePath, price, static_cast<int32_t>(quantity));
+            },
+            [callback](const Result &r) { respondProductCreated(Productcrud(r[0]), callback); },
+            [callback](const DrogonDbException &e) { respondProductInsertFailed(e.base().what(), callback); });
+    } catch (const std::exception &e) {
+        LOG_ERROR << "Server error: " << e.what();
+        callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
+    }
+}
+
+void productsControllers::createProductsBatch(const HttpRequestPtr &req,
+                                              std::function<void(const HttpResponsePtr &)> &&callback) {
+    LOG_DEBUG << "Processing POST /api/products/batch";
+    LOG_DEBUG << "Content-Type: " << req->getHeader("Content-Type");
+    LOG_DEBUG << "Request body size: " << req->getBody().length() << " bytes";
+
+    try {
+        auto client = DbRouter::instance().writer();
+        if (!client) {
+            LOG_ERROR << "Database client not initialized";
+            callback(createErrorResponse("Database client not initialized", k500InternalServerError));
+            return;
+        }
+
+        std::vector<Json::Value> items;
+        std::string errorMsg;
+        if (!parseBatchBody(req, items, errorMsg)) {
+            LOG_ERROR << errorMsg;
+            callback(createErrorResponse(errorMsg, k400BadRequest));
+            return;
+        }
+
+        // per-item results, valid items are filled in once the insert returns
+        auto results = std::make_shared<Json::Value>(Json::arrayValue);
+        std::vector<Json::ArrayIndex> validIndexes;
+        std::vector<std::string> titles, descriptions, images, prices, quantities;
+        for (size_t i = 0; i < items.size(); ++i) {
+            Json::Value entry;
+            entry["index"] = static_cast<Json::UInt64>(i);
+            Productcrud product;
+            std::string itemError;
+            if (items[i].isNull()) {
+                itemError = "Invalid JSON";
+            }
+            if (itemError.empty() && parseBatchItem(items[i], product, itemError)) {
+                validIndexes.push_back(static_cast<Json::ArrayIndex>(i));
+                titles.push_back(product.getValueOfTitle());
+                descriptions.push_back(product.getValueOfDescription());
+                images.push_back(product.getValueOfImage());
+                prices.push_back(fmt::format("{}", product.getValueOfPrice()));
+                quantities.push_back(std::to_string(product.getValueOfQuantity()));
+            } else {
+                entry["status"] = "error";
+                entry["error"] = itemError;
+            }
+            results->append(entry);
+        }
+
+        auto respond = [callback, results](size_t created) {
+            Json::Value res;
+            res["created"] = static_cast<Json::UInt64>(created);
+            res["failed"] = static_cast<Json::UInt64>(results->size() - created);
+            res["status"] = created == results->size() ? "success" : created == 0 ? "error" : "partial";
+            res["results"] = *results;
+            auto resp = HttpResponse::newHttpJsonResponse(res);
+            resp->setStatusCode(created == results->size() ? k201Created
+                                : created == 0          ? k400BadRequest
+                                                        : k207MultiStatus);
+            if (created == 0) {
+                callback(resp);
+                return;
+            }
+            respondAfterProductWrite(resp, callback);
+        };
+
+        if (validIndexes.empty()) {
+            LOG_ERROR << "No valid products in batch of " << items.size();
+            respond(0);
+            return;
+        }
 
-        mapper.insert(
-            product,
-            [callback](const Productcrud &p) {
+        LOG_DEBUG << "Inserting " << validIndexes.size() << " products in one statement";
+        client->execSqlAsync(
+            sqlForInsertingProductBatch(),
+            [respond, results, validIndexes](const Result &r) {
+                listingCache().bumpVersion();
+                // ids come from one sequence in insertion order, so sorting by id restores the input order
+                std::vector<Productcrud> rows;
+                rows.reserve(r.size());
+                for (const auto &row: r) {
+                    rows.emplace_back(row);
+                }
+                std::sort(rows.begin(), rows.end(), [](const Productcrud &a, const Productcrud &b) {
+                    return a.getValueOfId() < b.getValueOfId();
+                });
+                for (const auto &row: rows) {
+                    catalogWritten(row);
+                }
+                for (size_t i = 0; i < validIndexes.size() && i < rows.size(); ++i) {
+                    auto &entry = (*results)[validIndexes[i]];
+                    entry["status"] = "created";
+                    entry["data"] = rows[i].toJson();
+                }
+                LOG_INFO << "Batch created " << rows.size() << " products";
+                respond(rows.size());
+            },
+            [callback, results, validIndexes](const DrogonDbException &e) {
+                LOG_ERROR << "Database error: " << e.base().what();
+                for (auto index: validIndexes) {
+                    auto &entry = (*results)[index];
+                    entry["status"] = "error";
+                    entry["error"] = fmt::format("Database error: {}", e.base().what());
+                }
                 Json::Value res;
-                res["status"] = "success";
-                res["message"] = fmt::format("Product with title '{}' created successfully", p.getValueOfTitle());
-                Json::Value data;
-                data["id"] = p.getValueOfId();
-                data["title"] = p.getValueOfTitle();
-                data["description"] = p.getValueOfDescription();
-                data["price"] = p.getValueOfPrice();
-                data["quantity"] = p.getValueOfQuantity();
-                data["image"] = p.getValueOfImage();
-                res["data"] = data;
-                LOG_INFO << "Product created successfully: id=" << p.getValueOfId();
+                res["status"] = "error";
+                res["created"] = 0;
+                res["failed"] = static_cast<Json::UInt64>(results->size());
+                res["results"] = *results;
                 auto resp = HttpResponse::newHttpJsonResponse(res);
-                resp->setStatusCode(k201Created);
+                resp->setStatusCode(k500InternalServerError);
                 callback(resp);
             },
-            [callback](const DrogonDbException &e) {
-                LOG_ERROR << "Database error: " << e.base().what();
-                callback(createErrorResponse(fmt::format("Database error: {}", e.base().what()),
-                                             k500InternalServerError));
-            });
+            to_pg_array_literal(titles), to_pg_array_literal(descriptions), to_pg_array_literal(images),
+            to_pg_array_literal(prices), to_pg_array_literal(quantities));
+    } catch (const std::exception &e) {
+        LOG_ERROR << "Server error: " << e.what();
+        callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
+    }
+}
+
+void productsControllers::updateProducts(const HttpRequestPtr &req,
+                                         std::function<void(const HttpResponsePtr &)> &&callback, int id) {
+    LOG_DEBUG << "Processing PUT /api/updateProducts/" << id;
+    LOG_DEBUG << "Content-Type: " << req->getHeader("Content-Type");
+    LOG_DEBUG << "Request body size: " << req->getBody().length() << " bytes";
+    LOG_TRACE << "Raw request body (first 500 chars): " << toPrintableString(req->getBody());
+
+    try {
+        // Get database client
+        auto client = DbRouter::instance().writer();
+        if (!client) {
+            LOG_ERROR << "Database client not initialized";
+            callback(createErrorResponse("Database client not initialized", k500InternalServerError));
+            return;
+        }
+
+        // PUT is a patch that must carry every required field
+        ProductPatch patch;
+        std::string errorMsg;
+        if (!parseProductPatch(req, true, patch, errorMsg)) {
+            LOG_ERROR << errorMsg;
+            callback(createErrorResponse(errorMsg, k400BadRequest));
+            return;
+        }
+
+        std::optional<int64_t> expectedVersion;
+        if (!parseIfMatch(req, expectedVersion)) {
+            callback(createPreconditionFailedResponse(std::nullopt));
+            return;
+        }
+        if (!expectedVersion && ifMatchRequired()) {
+            callback(createErrorResponse("If-Match with the product's ETag is required", k428PreconditionRequired));
+            return;
+        }
+
+        LOG_DEBUG << "Updating product in database: id=" << id;
+        applyProductPatch(client, id, patch, expectedVersion, callback);
+    } catch (const std::exception &e) {
+        LOG_ERROR << "Server error: " << e.what();
+        callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
+    }
+}
+
+void productsControllers::patchProduct(const HttpRequestPtr &req,
+                                       std::function<void(const HttpResponsePtr &)> &&callback, int id) {
+    LOG_DEBUG << "Processing PATCH /api/product/" << id;
+    LOG_DEBUG << "Content-Type: " << req->getHeader("Content-Type");
+    LOG_TRACE << "Raw request body (first 500 chars): " << toPrintableString(req->getBody());
+
+    try {
+        auto client = DbRouter::instance().writer();
+        if (!client) {
+            LOG_ERROR << "Database client not initialized";
+            callback(createErrorResponse("Database client not initialized", k500InternalServerError));
+            return;
+        }
+
+        ProductPatch patch;
+        std::string errorMsg;
+        if (!parseProductPatch(req, false, patch, errorMsg)) {
+            LOG_ERROR << errorMsg;
+            callback(createErrorResponse(errorMsg, k400BadRequest));
+            return;
+        }
+
+        std::optional<int64_t> expectedVersion;
+        if (!parseIfMatch(req, expectedVersion)) {
+            callback(createPreconditionFailedResponse(std::nullopt));
+            return;
+        }
+        if (!expectedVersion && ifMatchRequired()) {
+            callback(createErrorResponse("If-Match with the product's ETag is required", k428PreconditionRequired));
+            return;
+        }
+
+        LOG_DEBUG << "Patching product in database: id=" << id;
+        applyProductPatch(client, id, patch, expectedVersion, callback);
+    } catch (const std::exception &e) {
+        LOG_ERROR << "Server error: " << e.what();
+        callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
+    }
+}
+
+void productsControllers::getAllProducts(const HttpRequestPtr &req,
+                                         std::function<void(const HttpResponsePtr &)> &&callback) {
+    try {
+        auto client = DbRouter::instance().freshReader(req);
+        if (!client) {
+            LOG_ERROR << "Database client not initialized";
+            callback(createErrorResponse("Database client not initialized", k500InternalServerError));
+            return;
+        }
+
+        // stream=true walks the catalog batch by batch; limit then caps the total instead of the page size
+        const auto &streamStr = req->getParameter("stream");
+        bool streaming = streamStr == "true" || streamStr == "1";
+        int64_t maxLimit = streaming ? std::numeric_limits<int64_t>::max() - 1 : kMaxPageSize;
+
+        int64_t limit = streaming ? maxLimit : kDefaultPageSize;
+        const auto &limitStr = req->getParameter("limit");
+        if (!limitStr.empty()) {
+            auto [ptr, ec] = std::from_chars(limitStr.data(), limitStr.data() + limitStr.size(), limit);
+            if (ec != std::errc() || ptr != limitStr.data() + limitStr.size() || limit <= 0 || limit > maxLimit) {
+                callback(createErrorResponse(fmt::format("limit must be between 1 and {}", maxLimit),
+                                             k400BadRequest));
+                return;
+            }
+        }
+
+        ProductFields fields;
+        std::string errorMsg;
+        if (!parseProductFields(req->getParameter("fields"), fields, errorMsg)) {
+            callback(createErrorResponse(errorMsg, k400BadRequest));
+            return;
+        }
+
+        CatalogColumns::Filter filter;
+        auto order = CatalogColumns::Order::Newest;
+        bool filtered = false;
+        if (!parseListingFilter(req, filter, order, filtered, errorMsg)) {
+            callback(createErrorResponse(errorMsg, k400BadRequest));
+            return;
+        }
+        const auto &cursorStr = req->getParameter("cursor");
+        // with serve_reads the plain listing is a snapshot page too, unless it continues a keyset cursor
+        if (!filtered && !streaming && (cursorStr.empty() || decode_sort_cursor(cursorStr)) && catalogForRead(req)) {
+            filtered = true;
+        }
+        if (filtered) {
+            if (streaming) {
+                callback(createErrorResponse("stream=true cannot be combined with filters or sort", k400BadRequest));
+                return;
+            }
+            std::optional<CatalogColumns::Key> after;
+            if (!cursorStr.empty()) {
+                auto cursor = decode_sort_cursor(cursorStr);
+                if (!cursor) {
+                    callback(createErrorResponse("Invalid cursor", k400BadRequest));
+                    return;
+                }
+                after = CatalogColumns::Key{cursor->key, cursor->id};
+            }
+            respondWithCatalogPage(filter, order, static_cast<size_t>(limit), after, fields, callback);
+            return;
+        }
+
+        std::optional<PageCursor> cursor;
+        if (!cursorStr.empty()) {
+            cursor = decode_page_cursor(cursorStr);
+            if (!cursor) {
+                callback(createErrorResponse("Invalid cursor", k400BadRequest));
+                return;
+            }
+        }
+
+        if (streaming) {
+            auto resp = HttpResponse::newAsyncStreamResponse(
+                [client, fields, cursor, limit](ResponseStreamPtr stream) {
+                    std::shared_ptr<ResponseStream> out = std::move(stream);
+                    if (!out->send(R"({"status":"success","message":"List of products fetched successfully","data":[)")) {
+                        out->close();
+                        return;
+                    }
+                    streamProductBatches(client, out, fields, cursor, limit, true);
+                });
+            resp->setContentTypeCode(CT_APPLICATION_JSON);
+            callback(resp);
+            return;
+        }
+
+        // the page is a pure function of its parameters and the catalog version, so it can be answered
+        // from the listing cache, or with a bare 304 when the client already holds it
+        auto &cache = listingCache();
+        auto cacheKey = fmt::format("{}|{}|{}", limit, cursorStr, fields.selectList());
+        auto version = cache.version();
+        auto etag = cache.etagFor(version, cacheKey);
+        if (ResponseCache::notModified(req, etag)) {
+            callback(ResponseCache::newNotModifiedResponse(etag));
+            return;
+        }
+        if (auto cached = cache.find(cacheKey)) {
+            callback(ResponseCache::toResponse(*cached, req));
+            return;
+        }
+
+        // one extra row tells whether another page exists
+        auto onRows = [req, callback, fields, limit, cacheKey, version](const Result &r) {
+            auto rows = std::min<size_t>(r.size(), static_cast<size_t>(limit));
+            Json::Value data(Json::arrayValue);
+            for (size_t i = 0; i < rows; ++i) {
+                data.append(fields.toJson(r[i]));
+            }
+
+            Json::Value result;
+            result["status"] = "success";
+            result["message"] = "List of products fetched successfully";
+            result["data"] = data;
+            if (r.size() > rows) {
+                const auto &last = r[rows - 1];
+                result["next_cursor"] = encode_page_cursor(
+                    {last["created_at"].as<std::string>(), last["id"].as<int32_t>()});
+            } else {
+                result["next_cursor"] = Json::Value();
+            }
+            Json::StreamWriterBuilder writer;
+            writer["indentation"] = "";
+            auto entry = listingCache().store(cacheKey, version, Json::writeString(writer, result));
+            callback(ResponseCache::toResponse(*entry, req));
+        };
+        auto onError = [callback](const DrogonDbException &e) {
+            LOG_ERROR << "Database error: " << e.base().what();
+            callback(createErrorResponse(fmt::format("Database error: {}", e.base().what()),
+                                         k500InternalServerError));
+        };
+
+        if (cursor) {
+            client->execSqlAsync(sqlForProductPageAfter(fields), std::move(onRows), std::move(onError),
+                                 cursor->created_at, cursor->id, limit + 1);
+        } else {
+            client->execSqlAsync(sqlForFirstProductPage(fields), std::move(onRows), std::move(onError), limit + 1);
+        }
     } catch (const std::exception &e) {
         LOG_ERROR << "Server error: " << e.what();
         callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
     }
 }
 
-void productsControllers::updateProducts(const HttpRequestPtr &req,
-                                         std::function<void(const HttpResponsePtr &)> &&callback, int id) {
-    LOG_DEBUG << "Processing PUT /api/products/" << id;
-    LOG_DEBUG << "Content-Type: " << req->getHeader("Content-Type");
-    LOG_DEBUG << "Request body size: " << req->getBody().length() << " bytes";
-    LOG_TRACE << "Raw request body (first 500 chars): " << toPrintableString(req->getBody());
-
+void productsControllers::searchProducts(const HttpRequestPtr &req,
+                                         std::function<void(const HttpResponsePtr &)> &&callback) {
     try {
-        // Get database client
-        auto client = app().getDbClient();
+        auto client = DbRouter::instance().reader(req);
         if (!client) {
             LOG_ERROR << "Database client not initialized";
             callback(createErrorResponse("Database client not initialized", k500InternalServerError));
             return;
         }
 
-        // Initialize product fields
-        std::string title, description, imagePath;
-        double price = 0.0;
-        int quantity = 0;
-        std::string errorMsg;
-        std::optional<std::string> contentType = req->getHeader("Content-Type");
+        const auto &q = req->getParameter("q");
+        if (q.empty() || q.size() > kMaxSearchQueryLength) {
+            callback(createErrorResponse(fmt::format("q must be 1 to {} characters", kMaxSearchQueryLength),
+                                         k400BadRequest));
+            return;
+        }
 
-        // Handle request based on Content-Type
-        if (contentType && contentType->find("multipart/form-data") != std::string::npos) {
-            // Parse multipart form-data
-            LOG_DEBUG << "Parsing multipart/form-data request";
-            MultiPartParser parser;
-            if (parser.parse(req) != 0) {
-                LOG_ERROR << "Failed to parse multipart form data. Content-Type: " << *contentType;
-                LOG_DEBUG << "Parser parameters count: " << parser.getParameters().size();
-                LOG_DEBUG << "Parser files count: " << parser.getFiles().size();
-                callback(createErrorResponse(
-                    "Failed to parse multipart form data. Ensure all required fields (title, description, price, quantity) and a valid image file (if provided) are included correctly.",
-                    k400BadRequest));
+        int64_t limit = kDefaultPageSize;
+        const auto &limitStr = req->getParameter("limit");
+        if (!limitStr.empty()) {
+            auto [ptr, ec] = std::from_chars(limitStr.data(), limitStr.data() + limitStr.size(), limit);
+            if (ec != std::errc() || ptr != limitStr.data() + limitStr.size() || limit <= 0 || limit > kMaxPageSize) {
+                callback(createErrorResponse(fmt::format("limit must be between 1 and {}", kMaxPageSize),
+                                             k400BadRequest));
                 return;
             }
+        }
 
-            // Extract form fields
-            const auto &parameters = parser.getParameters();
-            LOG_DEBUG << "Form fields received: " << parameters.size();
-            for (const auto &param: parameters) {
-                LOG_DEBUG << "Form field: " << param.first << " = " << param.second;
+        std::optional<SearchCursor> cursor;
+        const auto &cursorStr = req->getParameter("cursor");
+        if (!cursorStr.empty()) {
+            cursor = decode_search_cursor(cursorStr);
+            if (!cursor) {
+                callback(createErrorResponse("Invalid cursor", k400BadRequest));
+                return;
             }
+        }
 
-            title = parameters.find("title") != parameters.end() ? parameters.at("title") : "";
-            description = parameters.find("description") != parameters.end() ? parameters.at("description") : "";
-            auto priceStr = parameters.find("price") != parameters.end() ? parameters.at("price") : "";
-            auto quantityStr = parameters.find("quantity") != parameters.end() ? parameters.at("quantity") : "";
+        ProductFields fields;
+        std::string errorMsg;
+        if (!parseProductFields(req->getParameter("fields"), fields, errorMsg)) {
+            callback(createErrorResponse(errorMsg, k400BadRequest));
+            return;
+        }
+        bool highlight = req->getParameter("highlight") == "true";
 
-            // Check for missing fields
-            if (title.empty() || description.empty() || priceStr.empty() || quantityStr.empty()) {
-                LOG_ERROR << "Missing required fields: "
-                        << "title=" << (title.empty() ? "missing" : title) << ", "
-                        << "description=" << (description.empty() ? "missing" : description) << ", "
-                        << "price=" << (priceStr.empty() ? "missing" : priceStr) << ", "
-                        << "quantity=" << (quantityStr.empty() ? "missing" : quantityStr);
-                callback(createErrorResponse(
-                    "All required fields (title, description, price, quantity) must be provided", k400BadRequest));
-                return;
+        // the in-memory index matches plain terms; snippets and ?source=db still go to Postgres
+        if (searchIndexReady.load(std::memory_order_acquire) && !highlight && req->getParameter("source") != "db") {
+            auto match = req->getParameter("match") == "any" ? InvertedIndex::Match::Any : InvertedIndex::Match::All;
+            std::optional<InvertedIndex::Hit> after;
+            if (cursor) {
+                after = InvertedIndex::Hit{static_cast<uint32_t>(cursor->id), cursor->rank};
             }
+            respondWithIndexHits(client, searchIndex().search(q, match, static_cast<size_t>(limit) + 1, after),
+                                 static_cast<size_t>(limit), fields, callback);
+            return;
+        }
 
-            // Parse price and quantity
-            try {
-                price = std::stod(priceStr);
-                quantity = std::stoi(quantityStr);
-            } catch (const std::exception &e) {
-                LOG_ERROR << "Invalid price or quantity format: " << e.what();
-                callback(createErrorResponse("Invalid price or quantity format", k400BadRequest));
-                return;
+        // one extra row tells whether another page exists
+        auto onRows = [callback, fields, limit, highlight](const Result &r) {
+            auto rows = std::min<size_t>(r.size(), static_cast<size_t>(limit));
+            Json::Value data(Json::arrayValue);
+            for (size_t i = 0; i < rows; ++i) {
+                auto item = fields.toJson(r[i]);
+                item["rank"] = r[i]["rank"].as<double>();
+                if (highlight) {
+                    item["snippet"] = r[i]["snippet"].as<std::string>();
+                }
+                data.append(item);
             }
 
-            // Handle file upload
-            if (auto image = handleFileUpload(parser.getFiles(), errorMsg)) {
-                imagePath = *image;
-            } else if (!errorMsg.empty()) {
-                LOG_ERROR << errorMsg;
-                callback(createErrorResponse(errorMsg, k400BadRequest));
-                return;
+            Json::Value res;
+            res["status"] = "success";
+            res["data"] = data;
+            if (r.size() > rows) {
+                const auto &last = r[rows - 1];
+                res["next_cursor"] = encode_search_cursor({parseRank(last["rank"]), last["id"].as<int32_t>()});
+            } else {
+                res["next_cursor"] = Json::Value();
             }
+            auto resp = HttpResponse::newHttpJsonResponse(res);
+            resp->setStatusCode(k200OK);
+            callback(resp);
+        };
+        auto onError = [callback](const DrogonDbException &e) {
+            LOG_ERROR << "Database error: " << e.base().what();
+            callback(createErrorResponse(fmt::format("Database error: {}", e.base().what()),
+                                         k500InternalServerError));
+        };
+
+        if (cursor) {
+            client->execSqlAsync(sqlForSearch(fields, true, highlight), std::move(onRows), std::move(onError), q,
+                                 formatRank(cursor->rank), cursor->id, limit + 1);
         } else {
-            // Parse JSON body
-            LOG_DEBUG << "Parsing JSON body";
-            auto json = req->getJsonObject();
-            if (!json || json->empty()) {
-                LOG_ERROR << "Invalid or missing JSON body";
-                callback(createErrorResponse("Invalid or missing JSON body", k400BadRequest));
-                return;
-            }
+            client->execSqlAsync(sqlForSearch(fields, false, highlight), std::move(onRows), std::move(onError), q,
+                                 limit + 1);
+        }
+    } catch (const std::exception &e) {
+        LOG_ERROR << "Server error: " << e.what();
+        callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
+    }
+}
 
-            if (!json->isMember("title") || !json->isMember("description") ||
-                !json->isMember("price") || !json->isMember("quantity")) {
-                LOG_ERROR << "Missing required JSON fields";
-                callback(createErrorResponse("Missing required JSON fields: title, description, price, quantity",
-                                             k400BadRequest));
-                return;
-            }
+void productsControllers::registerStatements() {
+    static std::once_flag registered;
+    std::call_once(registered, registerProductStatements);
+}
 
-            title = (*json)["title"].asString();
-            description = (*json)["description"].asString();
-            price = (*json)["price"].asDouble();
-            quantity = (*json)["quantity"].asInt();
-            imagePath = json->isMember("image") ? (*json)["image"].asString() : "";
+Json::Value productsControllers::insertBatchingStats() {
+    Json::Value stats;
+    stats["enabled"] = insertBatchingEnabled();
+    if (!insertBatchingEnabled()) {
+        return stats;
+    }
+    auto &inserts = productInserts();
+    stats["batches"] = static_cast<Json::UInt64>(inserts.batches());
+    stats["rows"] = static_cast<Json::UInt64>(inserts.items());
+    stats["pending"] = static_cast<Json::UInt64>(inserts.pending());
+    stats["rows_per_batch"] =
+        inserts.batches() == 0 ? 0.0 : static_cast<double>(inserts.items()) / static_cast<double>(inserts.batches());
+    return stats;
+}
+
+ResponseCache &productsControllers::listingCache() {
+    // sized from custom_config on first use, which is after config.json is loaded
+    static ResponseCache cache = [] {
+        const auto &config = app().getCustomConfig()["cache"]["listings"];
+        return ResponseCache(config.get("capacity", 1024).asUInt64(),
+                             std::chrono::seconds(config.get("ttl_seconds", 60).asInt64()));
+    }();
+    return cache;
+}
+
+void productsControllers::getProductById(const HttpRequestPtr &req,
+                                         std::function<void(const HttpResponsePtr &)> &&callback, int id) {
+    try {
+        auto &router = DbRouter::instance();
+        if (!router.writer()) {
+            LOG_ERROR << "Database client not initialized";
+            callback(createErrorResponse("Database client not initialized", k500InternalServerError));
+            return;
         }
+        countPopularity(id, 1);
 
-        // Validate fields
-        if (!validateProductFields(title, description, price, quantity, errorMsg)) {
-            LOG_ERROR << errorMsg;
+        ProductFields fields;
+        std::string errorMsg;
+        if (!parseProductFields(req->getParameter("fields"), fields, errorMsg)) {
             callback(createErrorResponse(errorMsg, k400BadRequest));
             return;
         }
+        auto catalog = catalogForRead(req);
 
-        // Update product in database
-        LOG_DEBUG << "Updating product in database: id=" << id;
-        Mapper<Productcrud> mapper(client);
-        auto product = mapper.findByPrimaryKey(id);
-        product.setTitle(title);
-        product.setDescription(description);
-        product.setPrice(price);
-        product.setQuantity(quantity);
-        if (!imagePath.empty()) {
-            product.setImage(imagePath);
+        auto respond = [req, callback, id](const ProductLookupResult &lookup) {
+            if (!lookup.error.empty()) {
+                LOG_ERROR << "Database error: " << lookup.error;
+                callback(createErrorResponse(fmt::format("Database error: {}", lookup.error),
+                                             k500InternalServerError));
+                return;
+            }
+            if (lookup.data.isNull()) {
+                LOG_ERROR << "Product not found: id=" << id;
+                callback(createErrorResponse("Product not found", k404NotFound));
+                return;
+            }
+            // the version is the ETag writers hand back in If-Match
+            auto etag = productEtag(lookup.version);
+            if (ResponseCache::notModified(req, etag)) {
+                callback(ResponseCache::newNotModifiedResponse(etag));
+                return;
+            }
+            Json::Value res;
+            res["status"] = "success";
+            res["data"] = lookup.data;
+            auto resp = HttpResponse::newHttpJsonResponse(res);
+            resp->setStatusCode(k200OK);
+            resp->addHeader("ETag", etag);
+            callback(resp);
+        };
+
+        // the snapshot holds the whole catalog, so a product missing from it does not exist
+        if (catalog) {
+            auto row = catalog->find(id);
+            respond(row ? ProductLookupResult{projectJson(catalogRowJson(*catalog, *row), fields), {},
+                                              catalog->version(*row)}
+                        : ProductLookupResult{Json::Value(), {}});
+            return;
         }
 
-        mapper.update(
-            product,
-            [callback, title](size_t count) {
-                Json::Value res;
-                res["status"] = "success";
-                res["message"] = fmt::format("Product with title '{}' updated successfully", title);
-                LOG_INFO << "Product updated successfully";
-                auto resp = HttpResponse::newHttpJsonResponse(res);
-                resp->setStatusCode(k200OK);
-                callback(resp);
+        // whole rows are served from the read-through cache
+        if (fields.all()) {
+            if (auto product = CachedMapper<Productcrud>::findCached(id)) {
+                respond({product->toJson(), {}, product->getValueOfVersion()});
+                return;
+            }
+        }
+
+        // concurrent misses for the same id, projection and freshness requirement share one query, which
+        // may be hedged onto a second replica when the first is slow
+        auto minLsn = router.freshLsn(req);
+        auto sql = sqlForProductById(fields);
+        productLookups.run(
+            fmt::format("{}:{}:{}", minLsn, id, sql),
+            std::move(respond),
+            [&router, minLsn, sql, fields, id](const ProductLookups::Resolve &resolve) {
+                // read before querying so a write landing meanwhile keeps the stale row out of the cache
+                auto generation = CachedMapper<Productcrud>::cache().generation(id);
+                router.hedgedRead(
+                    minLsn,
+                    [sql, id](const DbClientPtr &client, ResultCallback &&rcb, ExceptionCallback &&ecb) {
+                        client->execSqlAsync(sql, std::move(rcb), std::move(ecb), id);
+                    },
+                    [resolve, fields, id, generation](const Result &r) {
+                        if (r.empty()) {
+                            resolve({Json::Value(), {}});
+                            return;
+                        }
+                        if (!fields.all()) {
+                            resolve({fields.toJson(r[0]), {}, r[0]["version"].as<int64_t>()});
+                            return;
+                        }
+                        Productcrud product(r[0]);
+                        // another instance may already have announced a newer version than this read saw
+                        if (InvalidationBus::instance().admit("product", std::to_string(id),
+                                                              product.getValueOfVersion())) {
+                            CachedMapper<Productcrud>::cache().put(id, product, generation);
+                        }
+                        resolve({product.toJson(), {}, product.getValueOfVersion()});
+                    },
+                    [resolve](const DrogonDbException &e) { resolve({Json::Value(), e.base().what()}); });
             },
-            [callback](const DrogonDbException &e) {
-                LOG_ERROR << "Database error: " << e.base().what();
-                callback(createErrorResponse(fmt::format("Database error: {}", e.base().what()),
-                                             k500InternalServerError));
+            [](std::exception_ptr error) {
+                try {
+                    std::rethrow_exception(error);
+                } catch (const std::exception &e) {
+                    return ProductLookupResult{Json::Value(), e.what()};
+                } catch (...) {
+                    return ProductLookupResult{Json::Value(), "unknown error"};
+                }
             });
-    } catch (const orm::UnexpectedRows &e) {
-        LOG_ERROR << "Product not found: " << e.what();
-        callback(createErrorResponse("Product not found", k404NotFound));
     } catch (const std::exception &e) {
         LOG_ERROR << "Server error: " << e.what();
         callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
     }
 }
 
-void productsControllers::getAllProducts(const HttpRequestPtr &req,
-                                         std::function<void(const HttpResponsePtr &)> &&callback) {
+void productsControllers::getProductsByIds(const HttpRequestPtr &req,
+                                           std::function<void(const HttpResponsePtr &)> &&callback) {
     try {
-        auto client = app().getDbClient();
+        auto client = DbRouter::instance().reader(req);
         if (!client) {
             LOG_ERROR << "Database client not initialized";
             callback(createErrorResponse("Database client not initialized", k500InternalServerError));
             return;
         }
 
-        Mapper<Productcrud> mapper(client);
-        auto products = mapper.findAll();
-        Json::Value data(Json::arrayValue);
-        for (const auto &p: products) {
-            data.append(p.toJson());
+        std::vector<int32_t> ids;
+        ProductFields fields;
+        std::string errorMsg;
+        if (!parseProductIds(req->getParameter("ids"), ids, errorMsg) ||
+            !parseProductFields(req->getParameter("fields"), fields, errorMsg)) {
+            callback(createErrorResponse(errorMsg, k400BadRequest));
+            return;
         }
 
-        Json::Value result;
-        result["status"] = "success";
-        result["message"] = "List of products fetched successfully";
-        result["data"] = data;
-        auto resp = HttpResponse::newHttpJsonResponse(result);
-        resp->setStatusCode(k200OK);
-        callback(resp);
+        lookupProductsByIds(client, ids, fields, callback);
     } catch (const std::exception &e) {
         LOG_ERROR << "Server error: " << e.what();
         callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
     }
 }
 
-void productsControllers::getProductById(const HttpRequestPtr &req,
-                                         std::function<void(const HttpResponsePtr &)> &&callback, int id) {
+void productsControllers::lookupProducts(const HttpRequestPtr &req,
+                                         std::function<void(const HttpResponsePtr &)> &&callback) {
     try {
-        auto client = app().getDbClient();
+        auto client = DbRouter::instance().reader(req);
         if (!client) {
             LOG_ERROR << "Database client not initialized";
             callback(createErrorResponse("Database client not initialized", k500InternalServerError));
             return;
         }
 
-        Mapper<Productcrud> mapper(client);
-        auto product = mapper.findByPrimaryKey(id);
-        Json::Value res;
-        res["status"] = "success";
-        res["data"] = product.toJson();
-        auto resp = HttpResponse::newHttpJsonResponse(res);
-        resp->setStatusCode(k200OK);
-        callback(resp);
-    } catch (const orm::UnexpectedRows &e) {
-        LOG_ERROR << "Product not found: " << e.what();
-        callback(createErrorResponse("Product not found", k404NotFound));
+        auto json = req->getJsonObject();
+        if (!json || !(*json)["ids"].isArray()) {
+            callback(createErrorResponse("Body must be a JSON object with an \"ids\" array", k400BadRequest));
+            return;
+        }
+
+        const auto idsRangeError = fmt::format("ids must list between 1 and {} product ids", kMaxLookupIds);
+        std::vector<int32_t> ids;
+        std::unordered_set<int32_t> seen;
+        for (const auto &id: (*json)["ids"]) {
+            if (!id.isInt()) {
+                callback(createErrorResponse("ids must be integers", k400BadRequest));
+                return;
+            }
+            if (seen.insert(id.asInt()).second) {
+                if (ids.size() == kMaxLookupIds) {
+                    callback(createErrorResponse(idsRangeError, k400BadRequest));
+                    return;
+                }
+                ids.push_back(id.asInt());
+            }
+        }
+        if (ids.empty()) {
+            callback(createErrorResponse(idsRangeError, k400BadRequest));
+            return;
+        }
+
+        ProductFields fields;
+        std::string errorMsg;
+        std::string fieldsParam = (*json)["fields"].isString() ? (*json)["fields"].asString()
+                                                               : req->getParameter("fields");
+        if (!parseProductFields(fieldsParam, fields, errorMsg)) {
+            callback(createErrorResponse(errorMsg, k400BadRequest));
+            return;
+        }
+
+        lookupProductsByIds(client, ids, fields, callback);
     } catch (const std::exception &e) {
         LOG_ERROR << "Server error: " << e.what();
         callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
@@ -481,26 +2804,268 @@ void productsControllers::getProductById(const HttpRequestPtr &req,
 void productsControllers::deleteProduct(const HttpRequestPtr &req,
                                         std::function<void(const HttpResponsePtr &)> &&callback, int id) {
     try {
-        auto client = app().getDbClient();
+        auto client = DbRouter::instance().writer();
         if (!client) {
             LOG_ERROR << "Database client not initialized";
             callback(createErrorResponse("Database client not initialized", k500InternalServerError));
             return;
         }
 
-        Mapper<Productcrud> mapper(client);
-        mapper.deleteByPrimaryKey(id);
+        std::optional<int64_t> expectedVersion;
+        if (!parseIfMatch(req, expectedVersion)) {
+            callback(createPreconditionFailedResponse(std::nullopt));
+            return;
+        }
+        if (!expectedVersion && ifMatchRequired()) {
+            callback(createErrorResponse("If-Match with the product's ETag is required", k428PreconditionRequired));
+            return;
+        }
+
+        auto onDeleted = [client, callback, id, expectedVersion](const size_t count) {
+            if (count == 0) {
+                if (expectedVersion) {
+                    respondToConditionalMiss(client, id, callback);
+                    return;
+                }
+                LOG_ERROR << "Product not found: id=" << id;
+                callback(createErrorResponse("Product not found", k404NotFound));
+                return;
+            }
+            listingCache().bumpVersion();
+            catalogDeleted(id);
+            Json::Value res;
+            res["status"] = "success";
+            res["message"] = "Product deleted successfully";
+            auto resp = HttpResponse::newHttpJsonResponse(res);
+            resp->setStatusCode(k200OK);
+            respondAfterProductWrite(resp, callback, id);
+        };
+        auto onError = [callback, id](const DrogonDbException &e) {
+            LOG_ERROR << "Database error: " << e.base().what();
+            listingCache().bumpVersion();
+            publishProductWrite(id, InvalidationBus::kUnversioned);
+            callback(createErrorResponse(fmt::format("Database error: {}", e.base().what()),
+                                         k500InternalServerError));
+        };
+
+        if (!expectedVersion) {
+            CachedMapper<Productcrud>(client).deleteByPrimaryKey(id, std::move(onDeleted), std::move(onError));
+            return;
+        }
+        // the conditional delete bypasses the mapper, so the cached row is evicted here
+        client->execSqlAsync(
+            sqlForDeletingProductIfVersion(),
+            [id, onDeleted](const Result &r) {
+                CachedMapper<Productcrud>::invalidate(id);
+                onDeleted(r.affectedRows());
+            },
+            [id, onError](const DrogonDbException &e) {
+                CachedMapper<Productcrud>::invalidate(id);
+                catalogChanged(id);
+                onError(e);
+            },
+            id, *expectedVersion);
+    } catch (const std::exception &e) {
+        LOG_ERROR << "Server error: " << e.what();
+        callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
+    }
+}
+
+void productsControllers::reserveProduct(const HttpRequestPtr &req,
+                                         std::function<void(const HttpResponsePtr &)> &&callback, int id) {
+    try {
+        changeStock(req, callback, id, true);
+    } catch (const std::exception &e) {
+        LOG_ERROR << "Server error: " << e.what();
+        callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
+    }
+}
+
+void productsControllers::releaseProduct(const HttpRequestPtr &req,
+                                         std::function<void(const HttpResponsePtr &)> &&callback, int id) {
+    try {
+        changeStock(req, callback, id, false);
+    } catch (const std::exception &e) {
+        LOG_ERROR << "Server error: " << e.what();
+        callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
+    }
+}
+
+void productsControllers::startHotSkus() {
+    auto &stock = hotStock();
+    if (stock.counters.empty()) {
+        return;
+    }
+    transferHotStock();
+    app().getLoop()->runEvery(stock.transferInterval, []() { transferHotStock(); });
+}
+
+void productsControllers::startSearchIndex() {
+    if (searchIndexEnabled()) {
+        searchIndex().beginLoad();
+        loadSearchIndex(0);
+    }
+}
+
+Json::Value productsControllers::searchIndexStats() {
+    Json::Value stats;
+    stats["enabled"] = searchIndexEnabled();
+    if (!searchIndexEnabled()) {
+        return stats;
+    }
+    auto &index = searchIndex();
+    stats["ready"] = searchIndexReady.load(std::memory_order_acquire);
+    stats["documents"] = static_cast<Json::UInt64>(index.documents());
+    stats["terms"] = static_cast<Json::UInt64>(index.terms());
+    stats["posting_bytes"] = static_cast<Json::UInt64>(index.postingBytes());
+    stats["document_bytes"] = static_cast<Json::UInt64>(index.documentBytes());
+    stats["term_bytes"] = static_cast<Json::UInt64>(index.termBytes());
+    return stats;
+}
+
+void productsControllers::suggestProducts(const HttpRequestPtr &req,
+                                          std::function<void(const HttpResponsePtr &)> &&callback) {
+    try {
+        auto &s = suggestions();
+        if (!s.enabled) {
+            callback(createErrorResponse("Suggestions are disabled", k404NotFound));
+            return;
+        }
+        auto index = s.index.load();
+        if (!index) {
+            callback(createErrorResponse("Suggestions are not loaded yet", k503ServiceUnavailable));
+            return;
+        }
+
+        const auto &prefix = req->getParameter("prefix");
+        if (prefix.empty() || prefix.size() > kMaxSearchQueryLength) {
+            callback(createErrorResponse(fmt::format("prefix must be 1 to {} characters", kMaxSearchQueryLength),
+                                         k400BadRequest));
+            return;
+        }
+
+        int64_t limit = static_cast<int64_t>(s.topK);
+        const auto &limitStr = req->getParameter("limit");
+        if (!limitStr.empty()) {
+            auto [ptr, ec] = std::from_chars(limitStr.data(), limitStr.data() + limitStr.size(), limit);
+            if (ec != std::errc() || ptr != limitStr.data() + limitStr.size() || limit <= 0 ||
+                limit > static_cast<int64_t>(s.topK)) {
+                callback(createErrorResponse(fmt::format("limit must be between 1 and {}", s.topK), k400BadRequest));
+                return;
+            }
+        }
+
+        Json::Value data(Json::arrayValue);
+        for (const auto *entry: index->suggest(prefix, static_cast<size_t>(limit))) {
+            Json::Value item;
+            item["id"] = entry->id;
+            item["title"] = entry->title;
+            data.append(item);
+        }
         Json::Value res;
         res["status"] = "success";
-        res["message"] = "Product deleted successfully";
+        res["data"] = data;
         auto resp = HttpResponse::newHttpJsonResponse(res);
         resp->setStatusCode(k200OK);
         callback(resp);
-    } catch (const orm::UnexpectedRows &e) {
-        LOG_ERROR << "Product not found: " << e.what();
-        callback(createErrorResponse("Product not found", k404NotFound));
     } catch (const std::exception &e) {
         LOG_ERROR << "Server error: " << e.what();
         callback(createErrorResponse(fmt::format("Server error: {}", e.what()), k500InternalServerError));
     }
 }
+
+void productsControllers::startSuggestions() {
+    auto &s = suggestions();
+    if (!s.enabled) {
+        return;
+    }
+    rebuildSuggestions();
+    app().getLoop()->runEvery(s.rebuildInterval, []() { rebuildSuggestions(); });
+}
+
+Json::Value productsControllers::suggestStats() {
+    auto &s = suggestions();
+    Json::Value stats;
+    stats["enabled"] = s.enabled;
+    if (!s.enabled) {
+        return stats;
+    }
+    auto index = s.index.load();
+    stats["ready"] = index != nullptr;
+    stats["titles"] = static_cast<Json::UInt64>(index ? index->size() : 0);
+    stats["nodes"] = static_cast<Json::UInt64>(index ? index->nodes() : 0);
+    stats["bytes"] = static_cast<Json::UInt64>(index ? index->bytes() : 0);
+    stats["builds"] = static_cast<Json::UInt64>(s.builds.load(std::memory_order_relaxed));
+    stats["last_build_ms"] = static_cast<double>(s.lastBuildMicros.load(std::memory_order_relaxed)) / 1000.0;
+    return stats;
+}
+
+void productsControllers::startCatalogSnapshot() {
+    auto &s = catalogSnapshot();
+    if (!s.enabled) {
+        return;
+    }
+    refreshCatalogSnapshot();
+    app().getLoop()->runEvery(s.applyInterval, []() { refreshCatalogSnapshot(); });
+    app().getLoop()->runEvery(s.reloadInterval,
+                              []() { catalogSnapshot().reloadDue.store(true, std::memory_order_relaxed); });
+
+    // other instances' writes arrive as NOTIFY with the product id as payload
+    if (s.listenConnection.empty()) {
+        return;
+    }
+    s.listener = DbListener::newPgListener(s.listenConnection);
+    s.listener->listen(s.listenChannel, [](const std::string &, const std::string &payload) {
+        int32_t id = 0;
+        auto [ptr, ec] = std::from_chars(payload.data(), payload.data() + payload.size(), id);
+        if (ec != std::errc() || ptr != payload.data() + payload.size()) {
+            LOG_WARN << "Ignoring catalog notification '" << payload << "'";
+            return;
+        }
+        catalogSnapshot().notifications.fetch_add(1, std::memory_order_relaxed);
+        catalogChanged(id);
+    });
+}
+
+Json::Value productsControllers::catalogSnapshotStats() {
+    auto &s = catalogSnapshot();
+    Json::Value stats;
+    stats["enabled"] = s.enabled;
+    if (!s.enabled) {
+        return stats;
+    }
+    auto columns = s.columns.load();
+    stats["ready"] = columns != nullptr;
+    stats["serve_reads"] = s.serveReads;
+    stats["rows"] = static_cast<Json::UInt64>(columns ? columns->size() : 0);
+    stats["bytes"] = static_cast<Json::UInt64>(columns ? columns->bytes() : 0);
+    stats["versions"] = static_cast<Json::UInt64>(s.columns.publishes());
+    stats["reloads"] = static_cast<Json::UInt64>(s.reloads.load(std::memory_order_relaxed));
+    stats["applied"] = static_cast<Json::UInt64>(s.applied.load(std::memory_order_relaxed));
+    stats["notifications"] = static_cast<Json::UInt64>(s.notifications.load(std::memory_order_relaxed));
+    stats["last_build_ms"] = static_cast<double>(s.lastBuildMicros.load(std::memory_order_relaxed)) / 1000.0;
+    {
+        std::lock_guard<std::mutex> lock(s.changedMutex);
+        stats["pending"] = static_cast<Json::UInt64>(s.changed.size());
+    }
+    return stats;
+}
+
+void productsControllers::subscribeInvalidations() {
+    // another instance wrote the product
+    InvalidationBus::instance().on("product", [](const std::string &key) {
+        int32_t id = 0;
+        auto [ptr, ec] = std::from_chars(key.data(), key.data() + key.size(), id);
+        if (ec != std::errc() || ptr != key.data() + key.size()) {
+            LOG_WARN << "Ignoring product invalidation '" << key << "'";
+            return;
+        }
+        CachedMapper<Productcrud>::invalidate(id);
+        listingCache().bumpVersion();
+        suggestions().titlesStale.store(true, std::memory_order_relaxed);
+        catalogChanged(id);
+        if (searchIndexEnabled()) {
+            remoteIndexUpdate(id);
+        }
+    });
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <drogon/HttpController.h>
+#include <tools/response_cache.h>
 
 using namespace drogon;
 
@@ -8,20 +9,75 @@ class productsControllers : public drogon::HttpController<productsControllers> {
 public:
     METHOD_LIST_BEGIN
         ADD_METHOD_TO(productsControllers::createProducts, "/api/products", Post);
+        ADD_METHOD_TO(productsControllers::createProductsBatch, "/api/products/batch", Post);
         ADD_METHOD_TO(productsControllers::getAllProducts, "/api/getProducts", Get);
         ADD_METHOD_TO(productsControllers::getProductById, "/api/product/{1}", Get);
+        ADD_METHOD_TO(productsControllers::getProductsByIds, "/api/products", Get);
+        ADD_METHOD_TO(productsControllers::lookupProducts, "/api/products/lookup", Post);
+        ADD_METHOD_TO(productsControllers::searchProducts, "/api/products/search", Get);
+        ADD_METHOD_TO(productsControllers::suggestProducts, "/api/products/suggest", Get);
         ADD_METHOD_TO(productsControllers::updateProducts, "/api/updateProducts/{1}", Put);
+        ADD_METHOD_TO(productsControllers::patchProduct, "/api/product/{1}", Patch);
         ADD_METHOD_TO(productsControllers::deleteProduct, "/api/deleteProduct/{1}", Delete);
+        ADD_METHOD_TO(productsControllers::reserveProduct, "/api/product/{1}/reserve", Post);
+        ADD_METHOD_TO(productsControllers::releaseProduct, "/api/product/{1}/release", Post);
     METHOD_LIST_END
 
     // functions to set repo
     static void createProducts(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback);
+    // bulk create from a JSON array or NDJSON body, one INSERT for the whole batch
+    static void createProductsBatch(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback);
     //
     void getAllProducts(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback);
     //
     void getProductById(const HttpRequestPtr &ptr, std::function<void (const HttpResponsePtr &)> &&callback, int id);
+    // multi-get, ?ids=1,2,3 resolved with a single query
+    void getProductsByIds(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback);
+    // same as getProductsByIds with the ids in a JSON body, for lists too long for a URL
+    void lookupProducts(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback);
+    // full-text search over title and description, ?q=&limit=&cursor=, best match first; served from the
+    // in-memory index once it is loaded
+    void searchProducts(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback);
+    // typeahead, ?prefix=&limit=, the most popular titles starting with prefix; answered from memory only
+    void suggestProducts(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback);
     //
     void updateProducts(const HttpRequestPtr &ptr, std::function<void (const HttpResponsePtr &)> &&callback, int id);
+    // partial update, only the fields present in the body are changed
+    void patchProduct(const HttpRequestPtr &ptr, std::function<void (const HttpResponsePtr &)> &&callback, int id);
     //
     void deleteProduct(const HttpRequestPtr &ptr, std::function<void (const HttpResponsePtr &)> &&callback , int id);
+    // atomically take {"quantity": n} (default 1) from stock, 409 when less than n is left
+    void reserveProduct(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback, int id);
+    // put {"quantity": n} (default 1) back into stock
+    void releaseProduct(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback, int id);
+
+    // serialised getProducts pages; every product write bumps its version
+    static ResponseCache &listingCache();
+
+    // write-behind batching of createProducts inserts (custom_config.products.insert_batching)
+    static Json::Value insertBatchingStats();
+
+    // bulk load the in-memory search index (custom_config.products.search_index); main.cc calls it at startup
+    static void startSearchIndex();
+
+    static Json::Value searchIndexStats();
+
+    // build the typeahead index and schedule its rebuilds (custom_config.products.suggest); called at startup
+    static void startSuggestions();
+
+    static Json::Value suggestStats();
+
+    // load the columnar catalog snapshot and keep merging changes into it (custom_config.products.catalog_snapshot)
+    static void startCatalogSnapshot();
+
+    static Json::Value catalogSnapshotStats();
+
+    // evict products written by other instances (tools/invalidation_bus.h); main.cc calls it before run()
+    static void subscribeInvalidations();
+
+    // lease the hot SKUs' first blocks of stock and keep topping them up; main.cc calls it once the db clients exist
+    static void startHotSkus();
+
+    // add the product queries to StatementRegistry; idempotent, main.cc calls it before the warm-up
+    static void registerStatements();
 };
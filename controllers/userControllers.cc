@@ -1,19 +1,108 @@
 #include "userControllers.h"
 #include <drogon/drogon.h>
-#include <drogon/orm/Mapper.h>
+#include <drogon/orm/CoroMapper.h>
 #include <drogon/utils/Utilities.h>  // For hashing
 #include <trantor/utils/Logger.h>
 #include "Usercase.h"
 #include <jwt-cpp/jwt.h>
+#include <tools/cached_mapper.h>
+#include <tools/statement_registry.h>
+#include <tools/db_router.h>
+#include <tools/invalidation_bus.h>
+#include <mutex>
+#include <optional>
+
+namespace {
+    // Create plain-text response
+    HttpResponsePtr newTextResponse(HttpStatusCode code, const std::string &body) {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(code);
+        resp->setBody(body);
+        return resp;
+    }
+
+    // The user statements, registered in StatementRegistry and prepared on every connection at startup;
+    // warm-up runs them in a transaction that is rolled back
+    void registerUserStatements() {
+        using Binder = PreparedStatement::Binder;
+        using drogon_model::shopapi::Usercase;
+        auto &registry = StatementRegistry::instance();
+        const auto &table = Usercase::tableName;
+        const std::string nilId = "00000000-0000-0000-0000-000000000000";
+
+        // Single-statement registration, see db/migrations/002_usercase_unique_email_username.sql
+        // the warm-up transactions are all open at once: a shared id, email or username would make each
+        // connection's insert wait for the previous connection's uncommitted row until the warm-up times out
+        registry.add("users.register",
+                     "insert into " + table + " (id, name, email, username, password) values ($1, $2, $3, $4, $5)"
+                     " on conflict do nothing returning id",
+                     [](Binder &binder) {
+                         auto unique = drogon::utils::getUuid();
+                         binder << unique << std::string() << "warm-up-" + unique + "@invalid"
+                                << "warm-up-" + unique << std::string();
+                     });
+        registry.add("users.find_by_email", "select * from " + table + " where email = $1",
+                     [](Binder &binder) { binder << std::string(); });
+        registry.add("users.find_by_username", "select * from " + table + " where username = $1",
+                     [](Binder &binder) { binder << std::string(); });
+        // the text drogon::orm::Mapper issues for findByPrimaryKey (CachedMapper, Profile)
+        registry.add("users.find_by_pk", Usercase::sqlForFindingByPrimaryKey(),
+                     [nilId](Binder &binder) { binder << nilId; });
+        // NULL parameters keep the stored value
+        registry.add("users.update_profile",
+                     "update " + table + " set name = coalesce($2, name), email = coalesce($3, email),"
+                     " username = coalesce($4, username), password = coalesce($5, password) where id = $1",
+                     [nilId](Binder &binder) { binder << nilId << nullptr << nullptr << nullptr << nullptr; });
+    }
+
+    const std::string &userSql(const std::string &name) {
+        userControllers::registerStatements();
+        return StatementRegistry::instance().get(name).sql;
+    }
+
+    const std::string &sqlForRegisteringUser() {
+        static const std::string &sql = userSql("users.register");
+        return sql;
+    }
+
+    const std::string &sqlForFindingUserByEmail() {
+        static const std::string &sql = userSql("users.find_by_email");
+        return sql;
+    }
+
+    const std::string &sqlForFindingUserByUsername() {
+        static const std::string &sql = userSql("users.find_by_username");
+        return sql;
+    }
+
+    const std::string &sqlForFindingUserById() {
+        static const std::string &sql = userSql("users.find_by_pk");
+        return sql;
+    }
+
+    const std::string &sqlForUpdatingProfile() {
+        static const std::string &sql = userSql("users.update_profile");
+        return sql;
+    }
+
+    std::optional<std::string> optionalString(const Json::Value &value) {
+        if (value.empty()) {
+            return std::nullopt;
+        }
+        return value.asString();
+    }
+}
+
+void userControllers::registerStatements() {
+    static std::once_flag registered;
+    std::call_once(registered, registerUserStatements);
+}
+
 // register
-void userControllers::Register(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+Task<HttpResponsePtr> userControllers::Register(HttpRequestPtr req) {
     auto json = req->getJsonObject();
     if (!json) {
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k400BadRequest);
-        resp->setBody("Invalid JSON");
-        callback(resp);
-        return;
+        co_return newTextResponse(k400BadRequest, "Invalid JSON");
     }
 
     std::string name = (*json)["name"].asString();
@@ -22,28 +111,11 @@ void userControllers::Register(const HttpRequestPtr &req, std::function<void(con
     std::string password = (*json)["password"].asString();
 
     if (name.empty() || email.empty() || username.empty() || password.empty()) {
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k400BadRequest);
-        resp->setBody("Missing required fields");
-        callback(resp);
-        return;
+        co_return newTextResponse(k400BadRequest, "Missing required fields");
     }
 
     try {
-        auto client = drogon::app().getDbClient();
-        drogon::orm::Mapper<drogon_model::shopapi::Usercase> mapper(client);
-
-        // Check for existing email or username
-        auto existing = mapper.findBy(
-            orm::Criteria(drogon_model::shopapi::Usercase::Cols::_email, orm::CompareOperator::EQ, email) ||
-            orm::Criteria(drogon_model::shopapi::Usercase::Cols::_username, orm::CompareOperator::EQ, username));
-        if (!existing.empty()) {
-            auto resp = HttpResponse::newHttpResponse();
-            resp->setStatusCode(k409Conflict);
-            resp->setBody("Email or username already exists");
-            callback(resp);
-            return;
-        }
+        auto client = DbRouter::instance().writer();
 
         // Generate UUID for id
         std::string userId = drogon::utils::getUuid();
@@ -51,16 +123,12 @@ void userControllers::Register(const HttpRequestPtr &req, std::function<void(con
         // Hash password
         std::string hashedPassword = drogon::utils::getSha256(password);
 
-        // Create Usercase model instance
-        drogon_model::shopapi::Usercase newUser;
-        newUser.setId(userId); // Set UUID as id
-        newUser.setName(name);
-        newUser.setEmail(email);
-        newUser.setUsername(username);
-        newUser.setPassword(hashedPassword);
-
-        // Insert into DB
-        mapper.insert(newUser);
+        // Insert into DB; the unique indexes on email/username turn a duplicate into an empty result
+        auto result = co_await client->execSqlCoro(sqlForRegisteringUser(), userId, name, email, username,
+                                                   hashedPassword);
+        if (result.empty()) {
+            co_return newTextResponse(k409Conflict, "Email or username already exists");
+        }
 
         // Return success with user ID
         Json::Value respJson;
@@ -68,24 +136,17 @@ void userControllers::Register(const HttpRequestPtr &req, std::function<void(con
         auto resp = HttpResponse::newHttpJsonResponse(respJson);
         resp->setStatusCode(k201Created);
         resp->setBody("User registered successfully");
-        callback(resp);
+        co_return co_await DbRouter::instance().afterWriteCoro(resp);
     } catch (const std::exception &e) {
         LOG_ERROR << "Register error: " << e.what();
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k500InternalServerError);
-        resp->setBody(std::string("Server error: ") + e.what());
-        callback(resp);
+        co_return newTextResponse(k500InternalServerError, std::string("Server error: ") + e.what());
     }
 }
 // login
-void userControllers::Login(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+Task<HttpResponsePtr> userControllers::Login(HttpRequestPtr req) {
     auto json = req->getJsonObject();
     if (!json) {
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k400BadRequest);
-        resp->setBody("Invalid JSON format");
-        callback(resp);
-        return;
+        co_return newTextResponse(k400BadRequest, "Invalid JSON format");
     }
 
     std::string email = (*json)["email"].asString();
@@ -93,43 +154,23 @@ void userControllers::Login(const HttpRequestPtr &req, std::function<void(const
     std::string password = (*json)["password"].asString();
 
     if ((email.empty() && username.empty()) || password.empty()) {
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k400BadRequest);
-        resp->setBody("Missing email/username or password");
-        callback(resp);
-        return;
+        co_return newTextResponse(k400BadRequest, "Missing email/username or password");
     }
 
     try {
-        auto client = drogon::app().getDbClient();
-        drogon::orm::Mapper<drogon_model::shopapi::Usercase> mapper(client);
-
-        std::vector<drogon_model::shopapi::Usercase> users;
-        if (!email.empty()) {
-            users = mapper.findBy(orm::Criteria(drogon_model::shopapi::Usercase::Cols::_email, orm::CompareOperator::EQ,
-                                                email));
-        } else if (!username.empty()) {
-            users = mapper.findBy(orm::Criteria(drogon_model::shopapi::Usercase::Cols::_username,
-                                                orm::CompareOperator::EQ, username));
-        }
+        auto client = DbRouter::instance().freshReader(req);
+        auto result = !email.empty() ? co_await client->execSqlCoro(sqlForFindingUserByEmail(), email)
+                                     : co_await client->execSqlCoro(sqlForFindingUserByUsername(), username);
 
-        if (users.empty()) {
-            auto resp = HttpResponse::newHttpResponse();
-            resp->setStatusCode(k401Unauthorized);
-            resp->setBody("Invalid email/username or password");
-            callback(resp);
-            return;
+        if (result.empty()) {
+            co_return newTextResponse(k401Unauthorized, "Invalid email/username or password");
         }
 
-        drogon_model::shopapi::Usercase user = users[0];
+        drogon_model::shopapi::Usercase user(result[0]);
         std::string hashedInput = drogon::utils::getSha256(password);
 
         if (hashedInput != user.getValueOfPassword()) {
-            auto resp = HttpResponse::newHttpResponse();
-            resp->setStatusCode(k401Unauthorized);
-            resp->setBody("Invalid email/username or password");
-            callback(resp);
-            return;
+            co_return newTextResponse(k401Unauthorized, "Invalid email/username or password");
         }
 
         // Generate JWT with UUID
@@ -146,45 +187,30 @@ void userControllers::Login(const HttpRequestPtr &req, std::function<void(const
 
         auto resp = HttpResponse::newHttpJsonResponse(respJson);
         resp->setStatusCode(k200OK);
-        callback(resp);
+        co_return resp;
     } catch (const std::exception &e) {
         LOG_ERROR << "Login error: " << e.what();
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k500InternalServerError);
-        resp->setBody(std::string("Server error: ") + e.what());
-        callback(resp);
+        co_return newTextResponse(k500InternalServerError, std::string("Server error: ") + e.what());
     }
 }
 
 
-void userControllers::Profile(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback) {
+Task<HttpResponsePtr> userControllers::Profile(HttpRequestPtr req) {
     auto authHeader = req->getHeader("Authorization");
     if (authHeader.empty()) {
         LOG_DEBUG << "No Authorization header provided";
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k401Unauthorized);
-        resp->setBody("Authorization header missing");
-        callback(resp);
-        return;
+        co_return newTextResponse(k401Unauthorized, "Authorization header missing");
     }
 
     if (authHeader.find("Bearer ") != 0 || authHeader.length() <= 7) {
         LOG_DEBUG << "Invalid Authorization header: " << authHeader;
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k401Unauthorized);
-        resp->setBody("Invalid or missing Bearer token");
-        callback(resp);
-        return;
+        co_return newTextResponse(k401Unauthorized, "Invalid or missing Bearer token");
     }
 
     std::string token = authHeader.substr(7);
     if (token.empty()) {
         LOG_DEBUG << "Token is empty after parsing";
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k401Unauthorized);
-        resp->setBody("Token is empty");
-        callback(resp);
-        return;
+        co_return newTextResponse(k401Unauthorized, "Token is empty");
     }
 
     std::string userId;
@@ -197,78 +223,64 @@ void userControllers::Profile(const HttpRequestPtr &req, std::function<void(cons
         userId = decoded.get_subject(); // UUID as string
     } catch (const jwt::error::token_verification_error &e) {
         LOG_DEBUG << "Invalid JWT token: ";
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k401Unauthorized);
-        resp->setBody("Invalid token");
-        callback(resp);
-        return;
+        co_return newTextResponse(k401Unauthorized, "Invalid token");
     } catch (const std::exception &e) {
         LOG_DEBUG << "Token parsing error: " << e.what();
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k401Unauthorized);
-        resp->setBody("Token is not a valid user ID");
-        callback(resp);
-        return;
+        co_return newTextResponse(k401Unauthorized, "Token is not a valid user ID");
     }
 
     try {
-        auto client = drogon::app().getDbClient();
-        drogon::orm::Mapper<drogon_model::shopapi::Usercase> mapper(client);
-        drogon_model::shopapi::Usercase user = mapper.findByPrimaryKey(userId);
+        using Cache = CachedMapper<drogon_model::shopapi::Usercase>;
+        auto user = Cache::findCached(userId);
+        if (!user) {
+            // read before querying so an eviction landing meanwhile keeps the stale row out of the cache
+            auto generation = Cache::cache().generation(userId);
+            auto client = DbRouter::instance().freshReader(req);
+            // the row read after this position covers every write up to it; a replica that has not replayed an
+            // update another instance announced must not refill the cache
+            auto position = co_await DbRouter::replayedPositionCoro(client);
+            auto result = co_await client->execSqlCoro(sqlForFindingUserById(), userId);
+            if (result.empty()) {
+                LOG_DEBUG << "User not found for ID: " << userId;
+                co_return newTextResponse(k404NotFound, "User not found");
+            }
+            user = drogon_model::shopapi::Usercase(result[0]);
+            if (position != 0 && InvalidationBus::instance().admit("user", userId, static_cast<int64_t>(position))) {
+                Cache::cache().put(userId, *user, generation);
+            }
+        }
 
         Json::Value userJson;
-        userJson["id"] = user.getValueOfId();
-        userJson["name"] = user.getValueOfName();
-        userJson["email"] = user.getValueOfEmail();
-        userJson["username"] = user.getValueOfUsername();
+        userJson["id"] = user->getValueOfId();
+        userJson["name"] = user->getValueOfName();
+        userJson["email"] = user->getValueOfEmail();
+        userJson["username"] = user->getValueOfUsername();
 
         auto resp = HttpResponse::newHttpJsonResponse(userJson);
         resp->setStatusCode(k200OK);
-        callback(resp);
-    } catch (const drogon::orm::UnexpectedRows &e) {
-        LOG_DEBUG << "User not found for ID: " << userId;
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k404NotFound);
-        resp->setBody("User not found");
-        callback(resp);
+        co_return resp;
     } catch (const std::exception &e) {
         LOG_ERROR << "Server error: " << e.what();
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k500InternalServerError);
-        resp->setBody(std::string("Server error: ") + e.what());
-        callback(resp);
+        co_return newTextResponse(k500InternalServerError, std::string("Server error: ") + e.what());
     }
 }
 
-void userControllers::updateProfile(const HttpRequestPtr &req,
-                                    std::function<void(const HttpResponsePtr &)> &&callback) {
+Task<HttpResponsePtr> userControllers::updateProfile(HttpRequestPtr req) {
     auto authHeader = req->getHeader("Authorization");
     if (authHeader.empty()) {
         LOG_DEBUG << "No Authorization header provided";
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k401Unauthorized);
-        resp->setBody("Authorization header missing");
-        callback(resp);
-        return;
+        co_return newTextResponse(k401Unauthorized, "Authorization header missing");
     }
 
     if (authHeader.find("Bearer ") != 0 || authHeader.length() <= 7) {
         LOG_DEBUG << "Invalid Authorization header: " << authHeader;
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k401Unauthorized);
-        resp->setBody("Invalid or missing Bearer token");
-        callback(resp);
-        return;
+        co_return newTextResponse(k401Unauthorized, "Invalid or missing Bearer token");
     }
 
     std::string token = authHeader.substr(7);
     if (token.empty()) {
         LOG_DEBUG << "Token is empty after parsing";
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k401Unauthorized);
-        resp->setBody("Token is empty");
-        callback(resp);
-        return;
+        co_return newTextResponse(k401Unauthorized, "Token is empty");
     }
 
     std::string userId;
@@ -281,58 +293,59 @@ void userControllers::updateProfile(const HttpRequestPtr &req,
         userId = decoded.get_subject(); // UUID as string
     } catch (const jwt::error::token_verification_error &e) {
         LOG_DEBUG << "Invalid JWT token: ";
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k401Unauthorized);
-        resp->setBody("Invalid token");
-        callback(resp);
-        return;
+        co_return newTextResponse(k401Unauthorized, "Invalid token");
     } catch (const std::exception &e) {
         LOG_DEBUG << "Token parsing error: " << e.what();
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k401Unauthorized);
-        resp->setBody("Token is not a valid user ID");
-        callback(resp);
-        return;
+        co_return newTextResponse(k401Unauthorized, "Token is not a valid user ID");
     }
 
     auto json = req->getJsonObject();
     if (!json) {
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k400BadRequest);
-        resp->setBody("Invalid JSON");
-        callback(resp);
-        return;
+        co_return newTextResponse(k400BadRequest, "Invalid JSON");
     }
 
     try {
-        auto client = drogon::app().getDbClient();
-        drogon::orm::Mapper<drogon_model::shopapi::Usercase> mapper(client);
-        drogon_model::shopapi::Usercase user = mapper.findByPrimaryKey(userId);
-
-        if (!(*json)["name"].empty()) user.setName((*json)["name"].asString());
-        if (!(*json)["email"].empty()) user.setEmail((*json)["email"].asString());
-        if (!(*json)["username"].empty()) user.setUsername((*json)["username"].asString());
-        if (!(*json)["password"].empty()) {
-            std::string newPass = (*json)["password"].asString();
-            user.setPassword(drogon::utils::getSha256(newPass));
+        auto client = DbRouter::instance().writer();
+        auto password = optionalString((*json)["password"]);
+        if (password) {
+            password = drogon::utils::getSha256(*password);
         }
 
-        mapper.update(user);
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k200OK);
-        resp->setBody("Profile updated");
-        callback(resp);
-    } catch (const drogon::orm::UnexpectedRows &e) {
-        LOG_DEBUG << "User not found for ID: " << userId;
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k404NotFound);
-        resp->setBody("User not found");
-        callback(resp);
+        // one UPDATE instead of read-modify-write; it bypasses the mapper, so the cached profile is evicted here
+        drogon::orm::Result result;
+        try {
+            result = co_await client->execSqlCoro(sqlForUpdatingProfile(), userId,
+                                                  optionalString((*json)["name"]),
+                                                  optionalString((*json)["email"]),
+                                                  optionalString((*json)["username"]), password);
+        } catch (...) {
+            CachedMapper<drogon_model::shopapi::Usercase>::invalidate(userId);
+            InvalidationBus::instance().publish("user", userId, InvalidationBus::kUnversioned);
+            throw;
+        }
+        CachedMapper<drogon_model::shopapi::Usercase>::invalidate(userId);
+        if (result.affectedRows() == 0) {
+            LOG_DEBUG << "User not found for ID: " << userId;
+            co_return newTextResponse(k404NotFound, "User not found");
+        }
+        // the table has no version column: the primary's position after the commit versions the update, since a
+        // read that starts once a server has replayed that far sees the new row
+        auto position = co_await DbRouter::instance().writePositionCoro();
+        InvalidationBus::instance().publish("user", userId,
+                                            position != 0 ? static_cast<int64_t>(position)
+                                                          : InvalidationBus::kUnversioned);
+        auto resp = co_await DbRouter::instance().afterWriteCoro(newTextResponse(k200OK, "Profile updated"), position);
+        // a Profile read on a lagging replica may have refilled the cache before the write position was known
+        CachedMapper<drogon_model::shopapi::Usercase>::invalidate(userId);
+        co_return resp;
     } catch (const std::exception &e) {
         LOG_ERROR << "Server error: " << e.what();
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k500InternalServerError);
-        resp->setBody(std::string("Server error: ") + e.what());
-        callback(resp);
+        co_return newTextResponse(k500InternalServerError, std::string("Server error: ") + e.what());
     }
 }
+
+void userControllers::subscribeInvalidations() {
+    InvalidationBus::instance().on("user", [](const std::string &key) {
+        CachedMapper<drogon_model::shopapi::Usercase>::invalidate(key);
+    });
+}
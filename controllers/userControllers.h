@@ -13,12 +13,19 @@ public:
         ADD_METHOD_TO(userControllers::updateProfile, "/api/update-profile", Put);
     METHOD_LIST_END
 
-    static void Register(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback);
+    // handlers are coroutines: the request is taken by value so it outlives every co_await
+    static Task<HttpResponsePtr> Register(HttpRequestPtr req);
 
-    static void Login(const HttpRequestPtr &req, std::function<void (const HttpResponsePtr &)> &&callback);
+    static Task<HttpResponsePtr> Login(HttpRequestPtr req);
 
-    static void Profile(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+    static Task<HttpResponsePtr> Profile(HttpRequestPtr req);
 
     //
-    static void updateProfile(const HttpRequestPtr &req, std::function<void(const HttpResponsePtr &)> &&callback);
+    static Task<HttpResponsePtr> updateProfile(HttpRequestPtr req);
+
+    // evict profiles updated by other instances (tools/invalidation_bus.h); main.cc calls it before run()
+    static void subscribeInvalidations();
+
+    // add the user queries to StatementRegistry; idempotent, main.cc calls it before the warm-up
+    static void registerStatements();
 };
@@ -0,0 +1,4 @@
+-- Registration relies on these to reject duplicates in a single INSERT ... ON CONFLICT;
+-- they also turn the login lookups by email/username into index scans.
+CREATE UNIQUE INDEX IF NOT EXISTS usercase_email_key ON public.UserCase (email);
+CREATE UNIQUE INDEX IF NOT EXISTS usercase_username_key ON public.UserCase (username);
@@ -0,0 +1,6 @@
+-- Keyset pagination of /api/getProducts walks (created_at, id); the key must never be NULL.
+UPDATE public.productcrud SET created_at = now() WHERE created_at IS NULL;
+ALTER TABLE public.productcrud ALTER COLUMN created_at SET DEFAULT now();
+ALTER TABLE public.productcrud ALTER COLUMN created_at SET NOT NULL;
+
+CREATE INDEX IF NOT EXISTS productcrud_created_at_id_idx ON public.productcrud (created_at, id);
@@ -0,0 +1,15 @@
+-- Optimistic concurrency for product writes: the version is the product's ETag and PUT/PATCH/DELETE
+-- with If-Match only apply while it is unchanged. A trigger bumps it so every UPDATE counts, whoever issues it.
+ALTER TABLE public.productcrud ADD COLUMN IF NOT EXISTS version bigint NOT NULL DEFAULT 1;
+
+CREATE OR REPLACE FUNCTION public.productcrud_bump_version() RETURNS trigger AS $$
+BEGIN
+    NEW.version := OLD.version + 1;
+    RETURN NEW;
+END;
+$$ LANGUAGE plpgsql;
+
+DROP TRIGGER IF EXISTS productcrud_bump_version ON public.productcrud;
+CREATE TRIGGER productcrud_bump_version
+    BEFORE UPDATE ON public.productcrud
+    FOR EACH ROW EXECUTE FUNCTION public.productcrud_bump_version();
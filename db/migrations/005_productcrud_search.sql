@@ -0,0 +1,9 @@
+-- Full-text search for /api/products/search: a stored tsvector kept up to date by Postgres itself, with
+-- title matches weighted above description matches. Adding the column rewrites the table once.
+ALTER TABLE public.productcrud ADD COLUMN IF NOT EXISTS search tsvector
+    GENERATED ALWAYS AS (
+        setweight(to_tsvector('english', coalesce(title, '')), 'A') ||
+        setweight(to_tsvector('english', coalesce(description, '')), 'B')
+    ) STORED;
+
+CREATE INDEX IF NOT EXISTS productcrud_search_idx ON public.productcrud USING gin (search);
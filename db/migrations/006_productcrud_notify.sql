@@ -0,0 +1,18 @@
+-- Change feed for the in-memory catalog snapshot (custom_config.products.catalog_snapshot.listen): every
+-- committed insert, update or delete sends the product id on productcrud_changes. Instances that LISTEN re-read
+-- the row from the primary, so the payload stays tiny and a burst of updates to one product costs one read.
+CREATE OR REPLACE FUNCTION public.productcrud_notify() RETURNS trigger AS $$
+BEGIN
+    IF TG_OP = 'DELETE' THEN
+        PERFORM pg_notify('productcrud_changes', OLD.id::text);
+    ELSE
+        PERFORM pg_notify('productcrud_changes', NEW.id::text);
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+DROP TRIGGER IF EXISTS productcrud_notify ON public.productcrud;
+CREATE TRIGGER productcrud_notify
+    AFTER INSERT OR UPDATE OR DELETE ON public.productcrud
+    FOR EACH ROW EXECUTE FUNCTION public.productcrud_notify();
@@ -0,0 +1,12 @@
+#!/bin/bash
+# Clone the primary on first start (-R writes standby.signal and primary_conninfo), then run as a hot standby
+set -e
+export PGDATA=/var/lib/postgresql/data
+if [ ! -s "$PGDATA/PG_VERSION" ]; then
+    until pg_basebackup -h primary -U replicator -D "$PGDATA" -R -X stream; do
+        echo "waiting for the primary..."
+        sleep 2
+    done
+    chmod 700 "$PGDATA"
+fi
+exec postgres -c hot_standby=on
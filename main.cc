@@ -1,13 +1,125 @@
 #include <drogon/drogon.h>
+#include <models/Productcrud.h>
+#include <models/Usercase.h>
+#include <tools/cached_mapper.h>
+#include <tools/statement_registry.h>
+#include <tools/db_router.h>
+#include <tools/invalidation_channel.h>
+#include <controllers/productsControllers.h>
+#include <controllers/userControllers.h>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
 
-int main() {
+namespace {
+    bool parsePort(const char *text, uint16_t &port) {
+        auto end = text + std::strlen(text);
+        auto [ptr, ec] = std::from_chars(text, end, port);
+        return ec == std::errc() && ptr == end && port != 0;
+    }
+
+    // The config file as drogon reads it (comments allowed)
+    bool readConfigFile(const std::string &path, Json::Value &config) {
+        std::ifstream file(path);
+        Json::CharReaderBuilder builder;
+        std::string errors;
+        if (!file || !Json::parseFromStream(builder, file, &config, &errors)) {
+            std::cerr << "cannot read " << path << ": " << errors << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    Json::Value &dbClientEntry(Json::Value &config, const std::string &name) {
+        for (auto &client: config["db_clients"]) {
+            if (client.get("name", "default").asString() == name) {
+                return client;
+            }
+        }
+        static Json::Value none;
+        return none;
+    }
+}
+
+//Usage: drogon_restapi [config file] [port], so several instances can run side by side on one machine
+int main(int argc, char *argv[]) {
+    uint16_t port = 9000;
+    if (argc > 3 || (argc > 2 && !parsePort(argv[2], port))) {
+        std::cerr << "usage: " << argv[0] << " [config file] [port 1-65535]" << std::endl;
+        return 2;
+    }
     //Set HTTP listener address and port
-    drogon::app().addListener("0.0.0.0", 9000);
+    drogon::app().addListener("0.0.0.0", port);
     //Load config file
-    drogon::app().loadConfigFile("../config.json");
+    Json::Value config;
+    if (!readConfigFile(argc > 1 ? argv[1] : "../config.json", config)) {
+        return 2;
+    }
+    //Queries outside the adaptive pool (coroutine and Mapper handlers, transactions, listings, lookups) share the
+    //primary's db client, so it gets as many connections as the pool may open; the pool connects with its settings
+    const auto &customConfig = config["custom_config"];
+    auto &primaryClient = dbClientEntry(config, customConfig["db_routing"].get("primary", "default").asString());
+    const auto &poolConfig = customConfig["db_pool"];
+    if (poolConfig.get("enabled", false).asBool() && primaryClient.isObject() &&
+        !primaryClient.get("is_fast", false).asBool()) {
+        auto maxConnections = poolConfig.get("max_connections", 16).asUInt();
+        if (primaryClient.get("number_of_connections", 1).asUInt() < maxConnections) {
+            primaryClient["number_of_connections"] = maxConnections;
+        }
+    }
+    drogon::app().loadConfigJson(config);
     //drogon::app().loadConfigFile("../config.yaml");
-    //Run HTTP framework,the method will block in the internal event loop
 
+    //Size the read-through model caches before the first request creates them
+    const auto &cacheConfig = drogon::app().getCustomConfig()["cache"];
+    auto configureCache = [](const Json::Value &config, auto configure) {
+        configure(config.get("capacity", 10000).asUInt64(),
+                  std::chrono::milliseconds(config.get("ttl_seconds", 60).asInt64() * 1000));
+    };
+    configureCache(cacheConfig["products"], CachedMapper<drogon_model::shopapi::Productcrud>::configure);
+    configureCache(cacheConfig["users"], CachedMapper<drogon_model::shopapi::Usercase>::configure);
+
+    //Writes go to the primary, reads to replicas that have caught up with the client's last write
+    DbRouter::instance().configure(drogon::app().getCustomConfig()["db_routing"]);
+    DbRouter::instance().configurePool(poolConfig, primaryClient);
+    drogon::app().registerBeginningAdvice([]() { DbRouter::instance().start(); });
+
+    //Stock of flash-sale products is leased from the database in blocks and sold from memory
+    drogon::app().registerBeginningAdvice([]() { productsControllers::startHotSkus(); });
+
+    //Optionally serve product search from an in-memory index loaded from the database
+    drogon::app().registerBeginningAdvice([]() { productsControllers::startSearchIndex(); });
+    drogon::app().registerBeginningAdvice([]() { productsControllers::startSuggestions(); });
+    drogon::app().registerBeginningAdvice([]() { productsControllers::startCatalogSnapshot(); });
+
+    //Writes are announced to the other instances, which evict the rows from their caches
+    productsControllers::subscribeInvalidations();
+    userControllers::subscribeInvalidations();
+    drogon::app().registerBeginningAdvice([]() {
+        InvalidationChannel::start(drogon::app().getCustomConfig()["invalidation"], InvalidationBus::instance());
+    });
+
+    //Prepare every registered statement on each pooled connection as soon as the DB clients exist;
+    //the warm-up holds all connections, so the first requests wait for it instead of preparing themselves
+    productsControllers::registerStatements();
+    userControllers::registerStatements();
+    const auto &statementConfig = drogon::app().getCustomConfig()["statements"];
+    if (statementConfig.get("warm_up", true).asBool()) {
+        // every connection of the primary's client, unless set
+        auto connections =
+            statementConfig.get("connections", primaryClient.get("number_of_connections", 1)).asUInt64();
+        auto timeout = std::chrono::milliseconds(statementConfig.get("timeout_seconds", 10).asInt64() * 1000);
+        drogon::app().registerBeginningAdvice([connections, timeout]() {
+            StatementRegistry::instance().warmUp(
+                DbRouter::instance().writer(), connections, timeout, [connections](size_t prepared, size_t failed) {
+                    LOG_INFO << "Prepared " << prepared << " statement(s) across " << connections
+                             << " connection(s), " << failed << " failure(s)";
+                });
+        });
+    }
+
+    //Run HTTP framework,the method will block in the internal event loop
     drogon::app().run();
 
     return 0;
@@ -20,6 +20,7 @@ const std::string Productcrud::Cols::_image = "\"image\"";
 const std::string Productcrud::Cols::_price = "\"price\"";
 const std::string Productcrud::Cols::_quantity = "\"quantity\"";
 const std::string Productcrud::Cols::_created_at = "\"created_at\"";
+const std::string Productcrud::Cols::_version = "\"version\"";
 const std::string Productcrud::primaryKeyName = "id";
 const bool Productcrud::hasPrimaryKey = true;
 const std::string Productcrud::tableName = "\"productcrud\"";
@@ -31,7 +32,8 @@ const std::vector<typename Productcrud::MetaData> Productcrud::metaData_={
 {"image","std::string","text",0,0,0,1},
 {"price","double","double precision",8,0,0,0},
 {"quantity","int32_t","integer",4,0,0,1},
-{"created_at","::trantor::Date","timestamp without time zone",0,0,0,0}
+{"created_at","::trantor::Date","timestamp without time zone",0,0,0,0},
+{"version","int64_t","bigint",8,0,0,1}
 };
 const std::string &Productcrud::getColumnName(size_t index) noexcept(false)
 {
@@ -88,11 +90,15 @@ Productcrud::Productcrud(const Row &r, const ssize_t indexOffset) noexcept
                 createdAt_=std::make_shared<::trantor::Date>(t*1000000+decimalNum);
             }
         }
+        if(!r["version"].isNull())
+        {
+            version_=std::make_shared<int64_t>(r["version"].as<int64_t>());
+        }
     }
     else
     {
         size_t offset = (size_t)indexOffset;
-        if(offset + 7 > r.size())
+        if(offset + 8 > r.size())
         {
             LOG_FATAL << "Invalid SQL result for this model";
             return;
@@ -151,13 +157,18 @@ Productcrud::Productcrud(const Row &r, const ssize_t indexOffset) noexcept
                 createdAt_=std::make_shared<::trantor::Date>(t*1000000+decimalNum);
             }
         }
+        index = offset + 7;
+        if(!r[index].isNull())
+        {
+            version_=std::make_shared<int64_t>(r[index].as<int64_t>());
+        }
     }
 
 }
 
 Productcrud::Productcrud(const Json::Value &pJson, const std::vector<std::string> &pMasqueradingVector) noexcept(false)
 {
-    if(pMasqueradingVector.size() != 7)
+    if(pMasqueradingVector.size() != 8)
     {
         LOG_ERROR << "Bad masquerading vector";
         return;
@@ -236,6 +247,14 @@ Productcrud::Productcrud(const Json::Value &pJson, const std::vector<std::string
             }
         }
     }
+    if(!pMasqueradingVector[7].empty() && pJson.isMember(pMasqueradingVector[7]))
+    {
+        dirtyFlag_[7] = true;
+        if(!pJson[pMasqueradingVector[7]].isNull())
+        {
+            version_=std::make_shared<int64_t>((int64_t)pJson[pMasqueradingVector[7]].asInt64());
+        }
+    }
 }
 
 Productcrud::Productcrud(const Json::Value &pJson) noexcept(false)
@@ -314,12 +333,20 @@ Productcrud::Productcrud(const Json::Value &pJson) noexcept(false)
             }
         }
     }
+    if(pJson.isMember("version"))
+    {
+        dirtyFlag_[7]=true;
+        if(!pJson["version"].isNull())
+        {
+            version_=std::make_shared<int64_t>((int64_t)pJson["version"].asInt64());
+        }
+    }
 }
 
 void Productcrud::updateByMasqueradedJson(const Json::Value &pJson,
                                             const std::vector<std::string> &pMasqueradingVector) noexcept(false)
 {
-    if(pMasqueradingVector.size() != 7)
+    if(pMasqueradingVector.size() != 8)
     {
         LOG_ERROR << "Bad masquerading vector";
         return;
@@ -397,6 +424,14 @@ void Productcrud::updateByMasqueradedJson(const Json::Value &pJson,
             }
         }
     }
+    if(!pMasqueradingVector[7].empty() && pJson.isMember(pMasqueradingVector[7]))
+    {
+        dirtyFlag_[7] = true;
+        if(!pJson[pMasqueradingVector[7]].isNull())
+        {
+            version_=std::make_shared<int64_t>((int64_t)pJson[pMasqueradingVector[7]].asInt64());
+        }
+    }
 }
 
 void Productcrud::updateByJson(const Json::Value &pJson) noexcept(false)
@@ -474,6 +509,14 @@ void Productcrud::updateByJson(const Json::Value &pJson) noexcept(false)
             }
         }
     }
+    if(pJson.isMember("version"))
+    {
+        dirtyFlag_[7] = true;
+        if(!pJson["version"].isNull())
+        {
+            version_=std::make_shared<int64_t>((int64_t)pJson["version"].asInt64());
+        }
+    }
 }
 
 const int32_t &Productcrud::getValueOfId() const noexcept
@@ -625,6 +668,23 @@ void Productcrud::setCreatedAtToNull() noexcept
     dirtyFlag_[6] = true;
 }
 
+const int64_t &Productcrud::getValueOfVersion() const noexcept
+{
+    static const int64_t defaultValue = int64_t();
+    if(version_)
+        return *version_;
+    return defaultValue;
+}
+const std::shared_ptr<int64_t> &Productcrud::getVersion() const noexcept
+{
+    return version_;
+}
+void Productcrud::setVersion(const int64_t &pVersion) noexcept
+{
+    version_ = std::make_shared<int64_t>(pVersion);
+    dirtyFlag_[7] = true;
+}
+
 void Productcrud::updateId(const uint64_t id)
 {
 }
@@ -637,7 +697,8 @@ const std::vector<std::string> &Productcrud::insertColumns() noexcept
         "image",
         "price",
         "quantity",
-        "created_at"
+        "created_at",
+        "version"
     };
     return inCols;
 }
@@ -710,6 +771,17 @@ void Productcrud::outputArgs(drogon::orm::internal::SqlBinder &binder) const
             binder << nullptr;
         }
     }
+    if(dirtyFlag_[7])
+    {
+        if(getVersion())
+        {
+            binder << getValueOfVersion();
+        }
+        else
+        {
+            binder << nullptr;
+        }
+    }
 }
 
 const std::vector<std::string> Productcrud::updateColumns() const
@@ -739,6 +811,10 @@ const std::vector<std::string> Productcrud::updateColumns() const
     {
         ret.push_back(getColumnName(6));
     }
+    if(dirtyFlag_[7])
+    {
+        ret.push_back(getColumnName(7));
+    }
     return ret;
 }
 
@@ -810,6 +886,17 @@ void Productcrud::updateArgs(drogon::orm::internal::SqlBinder &binder) const
             binder << nullptr;
         }
     }
+    if(dirtyFlag_[7])
+    {
+        if(getVersion())
+        {
+            binder << getValueOfVersion();
+        }
+        else
+        {
+            binder << nullptr;
+        }
+    }
 }
 Json::Value Productcrud::toJson() const
 {
@@ -870,6 +957,14 @@ Json::Value Productcrud::toJson() const
     {
         ret["created_at"]=Json::Value();
     }
+    if(getVersion())
+    {
+        ret["version"]=(Json::Int64)getValueOfVersion();
+    }
+    else
+    {
+        ret["version"]=Json::Value();
+    }
     return ret;
 }
 
@@ -882,7 +977,7 @@ Json::Value Productcrud::toMasqueradedJson(
     const std::vector<std::string> &pMasqueradingVector) const
 {
     Json::Value ret;
-    if(pMasqueradingVector.size() == 7)
+    if(pMasqueradingVector.size() == 8)
     {
         if(!pMasqueradingVector[0].empty())
         {
@@ -961,6 +1056,17 @@ Json::Value Productcrud::toMasqueradedJson(
                 ret[pMasqueradingVector[6]]=Json::Value();
             }
         }
+        if(!pMasqueradingVector[7].empty())
+        {
+            if(getVersion())
+            {
+                ret[pMasqueradingVector[7]]=(Json::Int64)getValueOfVersion();
+            }
+            else
+            {
+                ret[pMasqueradingVector[7]]=Json::Value();
+            }
+        }
         return ret;
     }
     LOG_ERROR << "Masquerade failed";
@@ -1020,6 +1126,14 @@ Json::Value Productcrud::toMasqueradedJson(
     {
         ret["created_at"]=Json::Value();
     }
+    if(getVersion())
+    {
+        ret["version"]=(Json::Int64)getValueOfVersion();
+    }
+    else
+    {
+        ret["version"]=Json::Value();
+    }
     return ret;
 }
 
@@ -1080,13 +1194,18 @@ bool Productcrud::validateJsonForCreation(const Json::Value &pJson, std::string
         if(!validJsonOfField(6, "created_at", pJson["created_at"], err, true))
             return false;
     }
+    if(pJson.isMember("version"))
+    {
+        if(!validJsonOfField(7, "version", pJson["version"], err, true))
+            return false;
+    }
     return true;
 }
 bool Productcrud::validateMasqueradedJsonForCreation(const Json::Value &pJson,
                                                      const std::vector<std::string> &pMasqueradingVector,
                                                      std::string &err)
 {
-    if(pMasqueradingVector.size() != 7)
+    if(pMasqueradingVector.size() != 8)
     {
         err = "Bad masquerading vector";
         return false;
@@ -1168,6 +1287,14 @@ bool Productcrud::validateMasqueradedJsonForCreation(const Json::Value &pJson,
                   return false;
           }
       }
+      if(!pMasqueradingVector[7].empty())
+      {
+          if(pJson.isMember(pMasqueradingVector[7]))
+          {
+              if(!validJsonOfField(7, pMasqueradingVector[7], pJson[pMasqueradingVector[7]], err, true))
+                  return false;
+          }
+      }
     }
     catch(const Json::LogicError &e)
     {
@@ -1218,13 +1345,18 @@ bool Productcrud::validateJsonForUpdate(const Json::Value &pJson, std::string &e
         if(!validJsonOfField(6, "created_at", pJson["created_at"], err, false))
             return false;
     }
+    if(pJson.isMember("version"))
+    {
+        if(!validJsonOfField(7, "version", pJson["version"], err, false))
+            return false;
+    }
     return true;
 }
 bool Productcrud::validateMasqueradedJsonForUpdate(const Json::Value &pJson,
                                                    const std::vector<std::string> &pMasqueradingVector,
                                                    std::string &err)
 {
-    if(pMasqueradingVector.size() != 7)
+    if(pMasqueradingVector.size() != 8)
     {
         err = "Bad masquerading vector";
         return false;
@@ -1270,6 +1402,11 @@ bool Productcrud::validateMasqueradedJsonForUpdate(const Json::Value &pJson,
           if(!validJsonOfField(6, pMasqueradingVector[6], pJson[pMasqueradingVector[6]], err, false))
               return false;
       }
+      if(!pMasqueradingVector[7].empty() && pJson.isMember(pMasqueradingVector[7]))
+      {
+          if(!validJsonOfField(7, pMasqueradingVector[7], pJson[pMasqueradingVector[7]], err, false))
+              return false;
+      }
     }
     catch(const Json::LogicError &e)
     {
@@ -1373,6 +1510,18 @@ bool Productcrud::validJsonOfField(size_t index,
                 return false;
             }
             break;
+        case 7:
+            if(pJson.isNull())
+            {
+                err="The " + fieldName + " column cannot be null";
+                return false;
+            }
+            if(!pJson.isInt64())
+            {
+                err="Type error in the "+fieldName+" field";
+                return false;
+            }
+            break;
         default:
             err="Internal error in the server";
             return false;
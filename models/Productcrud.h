@@ -51,6 +51,7 @@ class Productcrud
         static const std::string _price;
         static const std::string _quantity;
         static const std::string _created_at;
+        static const std::string _version;
     };
 
     static const int primaryKeyNumber;
@@ -163,8 +164,16 @@ class Productcrud
     void setCreatedAt(const ::trantor::Date &pCreatedAt) noexcept;
     void setCreatedAtToNull() noexcept;
 
+    /**  For column version  */
+    ///Get the value of the column version, returns the default value if the column is null
+    const int64_t &getValueOfVersion() const noexcept;
+    ///Return a shared_ptr object pointing to the column const value, or an empty shared_ptr object if the column is null
+    const std::shared_ptr<int64_t> &getVersion() const noexcept;
+    ///Set the value of the column version
+    void setVersion(const int64_t &pVersion) noexcept;
+
 
-    static size_t getColumnNumber() noexcept {  return 7;  }
+    static size_t getColumnNumber() noexcept {  return 8;  }
     static const std::string &getColumnName(size_t index) noexcept(false);
 
     Json::Value toJson() const;
@@ -193,6 +202,7 @@ class Productcrud
     std::shared_ptr<double> price_;
     std::shared_ptr<int32_t> quantity_;
     std::shared_ptr<::trantor::Date> createdAt_;
+    std::shared_ptr<int64_t> version_;
     struct MetaData
     {
         const std::string colName_;
@@ -204,7 +214,7 @@ class Productcrud
         const bool notNull_;
     };
     static const std::vector<MetaData> metaData_;
-    bool dirtyFlag_[7]={ false };
+    bool dirtyFlag_[8]={ false };
   public:
     static const std::string &sqlForFindingByPrimaryKey()
     {
@@ -255,6 +265,12 @@ class Productcrud
         {
             needSelection=true;
         }
+        sql += "version,";
+        ++parametersCount;
+        if(!dirtyFlag_[7])
+        {
+            needSelection=true;
+        }
         needSelection=true;
         if(parametersCount > 0)
         {
@@ -302,6 +318,15 @@ class Productcrud
         {
             sql +="default,";
         }
+        if(dirtyFlag_[7])
+        {
+            n = snprintf(placeholderStr,sizeof(placeholderStr),"$%d,",placeholder++);
+            sql.append(placeholderStr, n);
+        }
+        else
+        {
+            sql +="default,";
+        }
         if(parametersCount > 0)
         {
             sql.resize(sql.length() - 1);
@@ -0,0 +1,84 @@
+#include <drogon/drogon_test.h>
+#include "../tools/catalog_columns.h"
+#include <cmath>
+
+namespace {
+    std::vector<int32_t> ids(const CatalogColumns &columns, const std::vector<uint32_t> &rows) {
+        std::vector<int32_t> out;
+        for (auto row: rows) {
+            out.push_back(columns.id(row));
+        }
+        return out;
+    }
+}
+
+DROGON_TEST(CatalogColumnsTest)
+{
+    CatalogColumns columns;
+    // id, price, quantity, created_at; more than one SIMD step plus a tail
+    columns.append(1, 10.0, 5, 100, 1, "a", "first", std::nullopt);
+    columns.append(2, 25.5, 0, 200, 1, "b", std::nullopt, "b.png");
+    columns.append(3, NAN, 3, 300, 2, std::nullopt, "no price", std::nullopt);
+    columns.append(4, 5.0, 1, 300, 1, "d", "", std::nullopt);
+    columns.append(5, 25.5, 7, 150, 1, "e", "", std::nullopt);
+    columns.append(6, 99.0, -1, 50, 1, "f", "", std::nullopt);
+    columns.append(7, 10.0, 2, 400, 1, "g", "", std::nullopt);
+    REQUIRE(columns.size() == 7);
+
+    CHECK(*columns.title(1) == "b");
+    CHECK(!columns.title(2).has_value());
+    CHECK(!columns.description(1).has_value());
+    CHECK(columns.description(3)->empty());
+    CHECK(*columns.image(1) == "b.png");
+
+    CHECK(columns.select({}).size() == 7);
+    CHECK(ids(columns, columns.select({10.0, 25.5, false})) == std::vector<int32_t>({1, 2, 5, 7}));
+    CHECK(ids(columns, columns.select({std::nullopt, std::nullopt, true})) ==
+          std::vector<int32_t>({1, 3, 4, 5, 7}));
+    CHECK(ids(columns, columns.select({20.0, std::nullopt, true})) == std::vector<int32_t>({5}));
+
+    using Order = CatalogColumns::Order;
+    CHECK(ids(columns, columns.top({}, Order::Newest, 3)) == std::vector<int32_t>({7, 4, 3}));
+    CHECK(ids(columns, columns.top({}, Order::PriceAsc, 10)) == std::vector<int32_t>({4, 1, 7, 2, 5, 6}));
+    CHECK(ids(columns, columns.top({}, Order::PriceDesc, 3)) == std::vector<int32_t>({6, 5, 2}));
+    CHECK(ids(columns, columns.top({std::nullopt, std::nullopt, true}, Order::PriceDesc, 10)) ==
+          std::vector<int32_t>({5, 7, 1, 4}));
+
+    // keyset continuation, ties broken by id
+    auto first = columns.top({}, Order::PriceAsc, 2);
+    auto next = columns.top({}, Order::PriceAsc, 2, columns.key(first.back(), Order::PriceAsc));
+    CHECK(ids(columns, next) == std::vector<int32_t>({7, 2}));
+    auto newest = columns.top({}, Order::Newest, 2);
+    CHECK(ids(columns, columns.top({}, Order::Newest, 2, columns.key(newest.back(), Order::Newest))) ==
+          std::vector<int32_t>({3, 2}));
+}
+
+DROGON_TEST(CatalogColumnsMergeTest)
+{
+    CatalogColumns base;
+    for (int32_t id: {1, 3, 5, 7}) {
+        base.append(id, id * 1.0, id, id, 1, "product " + std::to_string(id), std::nullopt, std::nullopt);
+    }
+    CHECK(base.find(5) == 2u);
+    CHECK(!base.find(4).has_value());
+    CHECK(!base.find(8).has_value());
+
+    CatalogColumns changes;
+    changes.append(0, 0.5, 1, 1, 1, "new first", std::nullopt, std::nullopt);
+    changes.append(3, 30.0, 0, 3, 2, "product 3 renamed", std::nullopt, std::nullopt);
+    changes.append(9, 9.0, 9, 9, 1, "new last", std::nullopt, std::nullopt);
+
+    auto merged = CatalogColumns::merged(base, changes, {5});
+    REQUIRE(merged.size() == 5);
+    CHECK(merged.id(0) == 0);
+    CHECK(merged.id(2) == 3);
+    CHECK(merged.price(2) == 30.0);
+    CHECK(merged.version(2) == 2);
+    CHECK(*merged.title(2) == "product 3 renamed");
+    CHECK(!merged.find(5).has_value());
+    CHECK(*merged.title(*merged.find(7)) == "product 7");
+    CHECK(merged.id(4) == 9);
+    // the base is left as it was
+    CHECK(base.size() == 4);
+    CHECK(*base.title(1) == "product 3");
+}
@@ -0,0 +1,114 @@
+#include <drogon/drogon_test.h>
+#include "../tools/invalidation_bus.h"
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+
+DROGON_TEST(InvalidationBusTest)
+{
+    // two instances; whatever one drains is delivered to both, the way NOTIFY reaches the sender as well
+    InvalidationBus a(100, std::chrono::minutes(1));
+    InvalidationBus b(100, std::chrono::minutes(1));
+    std::vector<std::string> evictedA, evictedB;
+    a.on("product", [&](const std::string &key) { evictedA.push_back(key); });
+    b.on("product", [&](const std::string &key) { evictedB.push_back(key); });
+    a.setForwarding(true);
+    b.setForwarding(true);
+    auto deliver = [&](InvalidationBus &from) {
+        auto payloads = from.drain();
+        for (const auto &payload: payloads) {
+            a.receive(payload);
+            b.receive(payload);
+        }
+        return payloads.size();
+    };
+
+    // b cached version 3 of product 1; a writes version 4
+    CHECK(b.admit("product", "1", 3));
+    a.publish("product", "1", 4);
+    CHECK(deliver(a) == 1);
+    CHECK(evictedB == std::vector<std::string>{"1"});
+    CHECK(evictedA.empty()); // the writer's own echo is not newer than what it published
+    CHECK(!b.admit("product", "1", 3));
+    CHECK(b.admit("product", "1", 4));
+
+    // b writes version 5, then a late or repeated message for version 4 arrives: nothing is evicted again
+    b.publish("product", "1", 5);
+    deliver(b);
+    CHECK(evictedA == std::vector<std::string>{"1"});
+    auto late = InvalidationBus::encode({{"product", "1", 4}});
+    CHECK(a.receive(late) == 0);
+    CHECK(b.receive(late) == 0);
+    CHECK(evictedB.size() == 1);
+
+    // unversioned writes always evict and leave the floor alone
+    a.publish("product", "1", InvalidationBus::kUnversioned);
+    deliver(a);
+    CHECK(evictedA.size() == 2);
+    CHECK(evictedB.size() == 2);
+    CHECK(b.admit("product", "1", 5));
+
+    // a delete shuts the key for good
+    a.publish("product", "2", InvalidationBus::kDeleted);
+    deliver(a);
+    CHECK(evictedB.back() == "2");
+    CHECK(!b.admit("product", "2", 1000000));
+
+    // unknown entities and malformed messages are skipped
+    CHECK(b.receive(InvalidationBus::encode({{"order", "1", 1}})) == 0);
+    CHECK(b.receive("not json") == 0);
+    CHECK(b.receive(R"([{"entity":"product","key":7,"version":1},{"entity":"product","key":"3","version":9}])") == 1);
+    CHECK(b.receive(R"({"entity":"product","key":"4","version":1})") == 1);
+    CHECK(evictedB.back() == "4");
+}
+
+DROGON_TEST(InvalidationBusDrainTest)
+{
+    InvalidationBus bus(1000, std::chrono::minutes(1));
+    bus.publish("product", "1", 1);
+    CHECK(bus.drain().empty()); // not forwarding yet
+
+    bus.setForwarding(true);
+    for (int i = 0; i < 300; ++i) {
+        bus.publish("product", std::to_string(i), 2);
+    }
+    auto payloads = bus.drain(1000);
+    CHECK(payloads.size() > 1);
+    size_t messages = 0;
+    for (const auto &payload: payloads) {
+        CHECK(payload.size() <= 1000);
+        messages += InvalidationBus::decode(payload).size();
+    }
+    CHECK(messages == 300);
+    CHECK(bus.drain().empty());
+}
+
+DROGON_TEST(InvalidationBusFloorTest)
+{
+    InvalidationBus bus(100, std::chrono::milliseconds(50));
+    std::vector<std::string> evicted;
+    bus.on("user", [&](const std::string &key) { evicted.push_back(key); });
+
+    // nothing heard of yet: any fill is fine
+    CHECK(bus.admit("user", "u1", 0));
+
+    // an update at WAL position 500 arrives; reads that saw less of the WAL may be stale
+    CHECK(bus.receive(InvalidationBus::encode({{"user", "u1", 500}})) == 1);
+    CHECK(!bus.admit("user", "u1", 499));
+    CHECK(bus.admit("user", "u1", 500));
+    CHECK(bus.admit("user", "u2", 1)); // floors are per key
+    CHECK(bus.admit("product", "u1", 1)); // and per entity
+
+    // two updates reaching us in the wrong order: the older one evicts nothing and leaves the floor alone
+    CHECK(bus.receive(InvalidationBus::encode({{"user", "u1", 900}})) == 1);
+    CHECK(bus.receive(InvalidationBus::encode({{"user", "u1", 700}})) == 0);
+    CHECK(!bus.admit("user", "u1", 899));
+    CHECK(evicted.size() == 2);
+    CHECK(bus.stats()["stale"].asUInt64() == 1);
+    CHECK(bus.stats()["refused_fills"].asUInt64() == 2);
+
+    // floors are forgotten after the configured memory, like the cache entries they protect
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(bus.admit("user", "u1", 1));
+}
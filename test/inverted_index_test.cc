@@ -0,0 +1,80 @@
+#include <drogon/drogon_test.h>
+#include "../tools/inverted_index.h"
+
+namespace {
+    std::vector<uint32_t> idsOf(const std::vector<InvertedIndex::Hit> &hits) {
+        std::vector<uint32_t> ids;
+        for (const auto &hit: hits) {
+            ids.push_back(hit.id);
+        }
+        return ids;
+    }
+}
+
+DROGON_TEST(InvertedIndexTest)
+{
+    CHECK(InvertedIndex::tokenize("Red-Wine GLASS, 2x a") == std::vector<std::string>({"red", "wine", "glass", "2x"}));
+
+    InvertedIndex index;
+    index.upsert(1, "Red wine glass", "Crystal glass for red wine");
+    index.upsert(2, "White wine glass", "Tall glass");
+    index.upsert(3, "Red mug", "Ceramic");
+    CHECK(index.documents() == 3);
+
+    using Match = InvertedIndex::Match;
+    CHECK(idsOf(index.search("wine glass", Match::All, 10)) == std::vector<uint32_t>({2, 1}));
+    CHECK(idsOf(index.search("RED wine", Match::All, 10)) == std::vector<uint32_t>({1}));
+    CHECK(index.search("red unknown", Match::All, 10).empty());
+
+    // any-term search ranks products matching more of the terms first
+    auto hits = index.search("red wine", Match::Any, 10);
+    CHECK(idsOf(hits) == std::vector<uint32_t>({1, 3, 2}));
+    CHECK(hits[0].score == 1.0f);
+    CHECK(hits[1].score == 0.5f);
+
+    // pagination continues after the last hit
+    auto first = index.search("red wine", Match::Any, 2);
+    auto rest = index.search("red wine", Match::Any, 2, first.back());
+    CHECK(idsOf(rest) == std::vector<uint32_t>({2}));
+
+    // updates move a product between terms, removal drops it
+    index.upsert(3, "Wine mug", "Ceramic");
+    CHECK(idsOf(index.search("red", Match::All, 10)) == std::vector<uint32_t>({1}));
+    CHECK(idsOf(index.search("wine", Match::All, 10)) == std::vector<uint32_t>({3, 2, 1}));
+    index.remove(2);
+    CHECK(idsOf(index.search("wine", Match::All, 10)) == std::vector<uint32_t>({3, 1}));
+    CHECK(!index.insertIfAbsent(1, "nothing", ""));
+    CHECK(index.insertIfAbsent(2, "White wine glass", ""));
+
+    // a bulk load that read a product before it was deleted does not bring it back
+    index.beginLoad();
+    index.remove(3);
+    CHECK(!index.insertIfAbsent(3, "Red wine", ""));
+    index.endLoad();
+    CHECK(idsOf(index.search("wine", Match::All, 10)) == std::vector<uint32_t>({2, 1}));
+
+    // enough writes fold the pending lists into the compressed ones without changing results
+    for (uint32_t id = 100; id < 1100; ++id) {
+        index.upsert(id, id % 2 ? "odd lamp" : "even lamp", "");
+    }
+    for (uint32_t id = 100; id < 1100; id += 4) {
+        index.remove(id);
+    }
+    CHECK(index.search("even lamp", Match::All, 10000).size() == 250);
+    CHECK(index.search("odd", Match::All, 10000).size() == 500);
+    CHECK(index.search("lamp", Match::All, 3)[0].id == 1099);
+    CHECK(index.postingBytes() > 0);
+
+    // a term no product has any more is dropped, and its id goes to the next new term
+    auto terms = index.terms();
+    index.upsert(2000, "Zebra", "");
+    CHECK(index.terms() == terms + 1);
+    index.upsert(2000, "Yak", "");
+    CHECK(index.terms() == terms + 1);
+    CHECK(index.search("zebra", Match::Any, 10).empty());
+    CHECK(idsOf(index.search("yak", Match::All, 10)) == std::vector<uint32_t>({2000}));
+    index.remove(2000);
+    CHECK(index.terms() == terms);
+    CHECK(index.documentBytes() > 0);
+    CHECK(index.termBytes() > 0);
+}
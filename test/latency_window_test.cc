@@ -0,0 +1,30 @@
+#include <drogon/drogon_test.h>
+#include "../tools/latency_window.h"
+
+DROGON_TEST(LatencyWindowTest)
+{
+    LatencyWindow window(100, 95, 10);
+    for (uint64_t i = 1; i <= 9; ++i) {
+        window.record(i);
+    }
+    CHECK(!window.percentile().has_value());
+
+    for (uint64_t i = 10; i <= 100; ++i) {
+        window.record(i);
+    }
+    REQUIRE(window.percentile().has_value());
+    CHECK(*window.percentile() == 95);
+    CHECK(window.count() == 100);
+
+    // old samples fall out of the window
+    for (int i = 0; i < 100; ++i) {
+        window.record(1000);
+    }
+    CHECK(*window.percentile() == 1000);
+
+    LatencyWindow median(3, 50, 3);
+    median.record(30);
+    median.record(10);
+    median.record(20);
+    CHECK(*median.percentile() == 20);
+}
@@ -0,0 +1,28 @@
+#include <drogon/drogon_test.h>
+#include "../tools/lru_cache.h"
+#include <string>
+
+DROGON_TEST(LruCacheTest)
+{
+    // a single shard makes the eviction order deterministic
+    ShardedLruCache<int, std::string> cache(2, std::chrono::seconds(60), 1);
+    cache.put(1, "one");
+    cache.put(2, "two");
+    CHECK(cache.get(1) == std::optional<std::string>("one"));
+    cache.put(3, "three");
+    CHECK(!cache.get(2).has_value());
+    CHECK(cache.get(3).has_value());
+    CHECK(cache.evictions() == 1);
+    CHECK(cache.hits() == 2);
+    CHECK(cache.misses() == 1);
+
+    // a fill that raced with an invalidation is dropped
+    auto generation = cache.generation(1);
+    cache.erase(1);
+    CHECK(!cache.put(1, "stale", generation));
+    CHECK(!cache.get(1).has_value());
+
+    ShardedLruCache<int, int> expiring(8, std::chrono::milliseconds(0));
+    expiring.put(1, 1);
+    CHECK(!expiring.get(1).has_value());
+}
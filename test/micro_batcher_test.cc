@@ -0,0 +1,49 @@
+#include <drogon/drogon_test.h>
+#include "../tools/micro_batcher.h"
+#include <string>
+
+DROGON_TEST(MicroBatcherTest)
+{
+    std::vector<std::function<void()>> timers;
+    std::vector<std::vector<int>> flushed;
+    std::vector<MicroBatcher<int, std::string>::Resolve> resolvers;
+    MicroBatcher<int, std::string> batcher(
+        3,
+        std::chrono::milliseconds(2),
+        [&](std::vector<int> &&items, MicroBatcher<int, std::string>::Resolve resolve) {
+            flushed.push_back(items);
+            resolvers.push_back(std::move(resolve));
+        },
+        [&](std::chrono::microseconds, std::function<void()> fire) { timers.push_back(std::move(fire)); });
+
+    std::vector<std::string> seen;
+    auto done = [&](const std::string &outcome) { seen.push_back(outcome); };
+
+    // a full batch is flushed at once and its timer becomes a no-op
+    batcher.add(1, done);
+    batcher.add(2, done);
+    CHECK(flushed.empty());
+    CHECK(batcher.pending() == 2);
+    batcher.add(3, done);
+    REQUIRE(flushed.size() == 1);
+    CHECK(flushed[0] == std::vector<int>({1, 2, 3}));
+    CHECK(timers.size() == 1);
+    timers[0]();
+    CHECK(flushed.size() == 1);
+
+    // each caller gets its own outcome
+    resolvers[0]({"a", "b", "c"});
+    CHECK(seen == std::vector<std::string>({"a", "b", "c"}));
+
+    // a partial batch leaves when its window elapses
+    batcher.add(4, done);
+    REQUIRE(timers.size() == 2);
+    timers[1]();
+    REQUIRE(flushed.size() == 2);
+    CHECK(flushed[1] == std::vector<int>({4}));
+    resolvers[1]({"d"});
+    CHECK(seen.back() == "d");
+    CHECK(batcher.batches() == 2);
+    CHECK(batcher.items() == 4);
+    CHECK(batcher.pending() == 0);
+}
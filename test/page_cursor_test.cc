@@ -0,0 +1,54 @@
+#include <drogon/drogon_test.h>
+#include "../tools/page_cursor.h"
+
+DROGON_TEST(PageCursorTest)
+{
+    PageCursor cursor{"2024-05-01 12:30:45.123456", 42};
+    auto token = encode_page_cursor(cursor);
+    CHECK(token.find_first_not_of("0123456789abcdef") == std::string::npos);
+
+    auto decoded = decode_page_cursor(token);
+    REQUIRE(decoded.has_value());
+    CHECK(decoded->created_at == cursor.created_at);
+    CHECK(decoded->id == 42);
+
+    CHECK(!decode_page_cursor("").has_value());
+    CHECK(!decode_page_cursor("abc").has_value());
+    CHECK(!decode_page_cursor("zz").has_value());
+    CHECK(!decode_page_cursor(encode_page_cursor({"2024-05-01", 7}) + "00").has_value());
+    CHECK(!decode_page_cursor(encode_page_cursor({"'; drop table x; --", 1})).has_value());
+}
+
+DROGON_TEST(SearchCursorTest)
+{
+    SearchCursor cursor{0.0759909f, 17};
+    auto decoded = decode_search_cursor(encode_search_cursor(cursor));
+    REQUIRE(decoded.has_value());
+    CHECK(decoded->rank == cursor.rank);
+    CHECK(decoded->id == 17);
+
+    auto tiny = decode_search_cursor(encode_search_cursor({1e-7f, 3}));
+    REQUIRE(tiny.has_value());
+    CHECK(tiny->rank == 1e-7f);
+
+    // listing and search cursors are not interchangeable
+    CHECK(!decode_search_cursor(encode_page_cursor({"2024-05-01 12:30:45", 1})).has_value());
+    CHECK(!decode_page_cursor(encode_search_cursor(cursor)).has_value());
+    CHECK(!decode_search_cursor("").has_value());
+    CHECK(!decode_search_cursor(encode_page_cursor({"s", 1})).has_value());
+}
+
+DROGON_TEST(SortCursorTest)
+{
+    for (double key: {19.99, 0.1, -3.5, 1714566645123456.0}) {
+        auto decoded = decode_sort_cursor(encode_sort_cursor({key, 42}));
+        REQUIRE(decoded.has_value());
+        CHECK(decoded->key == key);
+        CHECK(decoded->id == 42);
+    }
+
+    CHECK(!decode_sort_cursor(encode_search_cursor({0.5f, 1})).has_value());
+    CHECK(!decode_search_cursor(encode_sort_cursor({0.5, 1})).has_value());
+    CHECK(!decode_page_cursor(encode_sort_cursor({0.5, 1})).has_value());
+    CHECK(!decode_sort_cursor("").has_value());
+}
@@ -0,0 +1,9 @@
+#include <drogon/drogon_test.h>
+#include "../tools/pg_array.h"
+
+DROGON_TEST(PgArrayLiteralTest)
+{
+    CHECK(to_pg_array_literal({}) == "{}");
+    CHECK(to_pg_array_literal({"a", ""}) == R"({"a",""})");
+    CHECK(to_pg_array_literal({"say \"hi\"", R"(c:\dir)", "{x,y}"}) == R"({"say \"hi\"","c:\\dir","{x,y}"})");
+}
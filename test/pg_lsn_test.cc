@@ -0,0 +1,21 @@
+#include <drogon/drogon_test.h>
+#include "../tools/pg_lsn.h"
+
+DROGON_TEST(PgLsnTest)
+{
+    auto lsn = parse_pg_lsn("16/B374D848");
+    REQUIRE(lsn.has_value());
+    CHECK(*lsn == 0x16B374D848ull);
+    CHECK(format_pg_lsn(*lsn) == "16/B374D848");
+    CHECK(format_pg_lsn(0) == "0/0");
+
+    // ordering follows the WAL
+    CHECK(*parse_pg_lsn("0/FFFFFFFF") < *parse_pg_lsn("1/0"));
+
+    CHECK(!parse_pg_lsn("").has_value());
+    CHECK(!parse_pg_lsn("16B374D848").has_value());
+    CHECK(!parse_pg_lsn("/1").has_value());
+    CHECK(!parse_pg_lsn("1/").has_value());
+    CHECK(!parse_pg_lsn("1/G").has_value());
+    CHECK(!parse_pg_lsn("123456789/0").has_value());
+}
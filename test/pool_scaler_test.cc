@@ -0,0 +1,43 @@
+#include <drogon/drogon_test.h>
+#include "../tools/pool_scaler.h"
+
+DROGON_TEST(PoolScalerTest)
+{
+    PoolScaler::Options options;
+    options.minSize = 2;
+    options.maxSize = 8;
+    options.growQueueDepth = 2;
+    options.growWaitMs = 5;
+    options.maxQueryMs = 100;
+    options.shrinkUtilization = 0.5;
+    options.shrinkAfter = 3;
+    PoolScaler scaler(options);
+
+    // below the floor: open the missing connections
+    CHECK(scaler.decide({0, 0, 0, 0, 0}) == 2);
+
+    // a queue grows the pool, at most doubling it
+    CHECK(scaler.decide({2, 2, 5, 1, 10}) == 2);
+    CHECK(scaler.decide({4, 4, 1, 2, 10}) == 0);
+    CHECK(scaler.decide({4, 4, 1, 8, 10}) == 1);
+    CHECK(scaler.decide({7, 7, 6, 20, 10}) == 1);
+    CHECK(scaler.decide({8, 8, 6, 20, 10}) == 0);
+
+    // a slow server is not given more connections
+    CHECK(scaler.decide({4, 4, 6, 20, 500}) == 0);
+
+    // sustained low use closes one connection at a time
+    CHECK(scaler.decide({4, 1, 0, 0, 1}) == 0);
+    CHECK(scaler.decide({4, 1, 0, 0, 1}) == 0);
+    CHECK(scaler.decide({4, 1, 0, 0, 1}) == -1);
+    CHECK(scaler.decide({3, 1, 0, 0, 1}) == 0);
+    // a busy interval restarts the count
+    CHECK(scaler.decide({3, 3, 0, 0, 1}) == 0);
+    CHECK(scaler.decide({3, 1, 0, 0, 1}) == 0);
+    CHECK(scaler.decide({3, 1, 0, 0, 1}) == 0);
+    CHECK(scaler.decide({3, 1, 0, 0, 1}) == -1);
+    // never below the floor
+    for (int i = 0; i < 10; ++i) {
+        CHECK(scaler.decide({2, 0, 0, 0, 0}) == 0);
+    }
+}
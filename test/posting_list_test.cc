@@ -0,0 +1,68 @@
+#include <drogon/drogon_test.h>
+#include "../tools/posting_list.h"
+#include <algorithm>
+#include <random>
+
+namespace {
+    std::vector<uint32_t> randomIds(std::mt19937 &rng, size_t count, uint32_t max) {
+        std::uniform_int_distribution<uint32_t> pick(1, max);
+        std::vector<uint32_t> ids;
+        for (size_t i = 0; i < count; ++i) {
+            ids.push_back(pick(rng));
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        return ids;
+    }
+}
+
+DROGON_TEST(PostingListTest)
+{
+    std::mt19937 rng(7);
+    auto ids = randomIds(rng, 1000, 100000);
+    ids.push_back(4000000000u); // gaps wider than 28 bits take a five-byte varint
+    PostingList list(ids);
+    CHECK(list.size() == ids.size());
+    CHECK(list.bytes() < ids.size() * sizeof(uint32_t));
+
+    std::vector<uint32_t> decoded;
+    list.decode(decoded);
+    CHECK(decoded == ids);
+
+    // a range decode covers at least the ids inside the range, whole blocks at a time
+    std::vector<uint32_t> range;
+    list.decodeRange(ids[300], ids[310], range);
+    CHECK(range.size() == PostingList::kBlockSize);
+    CHECK(std::is_sorted(range.begin(), range.end()));
+    CHECK(std::find(range.begin(), range.end(), ids[305]) != range.end());
+    range.clear();
+    list.decodeRange(ids.back() + 1, ids.back() + 1, range);
+    CHECK(range.empty());
+
+    CHECK(PostingList().empty());
+}
+
+DROGON_TEST(SortedSetOpsTest)
+{
+    std::mt19937 rng(11);
+    for (int round = 0; round < 50; ++round) {
+        auto a = randomIds(rng, 1 + rng() % 300, 2000);
+        auto b = randomIds(rng, 1 + rng() % 300, 2000);
+
+        std::vector<uint32_t> expected;
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+        std::vector<uint32_t> out(std::min(a.size(), b.size()));
+        out.resize(intersect_sorted(a.data(), a.size(), b.data(), b.size(), out.data()));
+        CHECK(out == expected);
+
+        expected.clear();
+        std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+        out.assign(a.size() + b.size(), 0);
+        out.resize(union_sorted(a.data(), a.size(), b.data(), b.size(), out.data()));
+        CHECK(out == expected);
+    }
+
+    uint32_t none[1];
+    std::vector<uint32_t> a = {1, 2, 3, 4, 5, 6, 7, 8};
+    CHECK(intersect_sorted(a.data(), a.size(), nullptr, 0, none) == 0);
+}
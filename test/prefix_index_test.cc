@@ -0,0 +1,45 @@
+#include <drogon/drogon_test.h>
+#include "../tools/prefix_index.h"
+
+namespace {
+    std::vector<uint32_t> ids(const std::vector<const PrefixIndex::Entry *> &entries) {
+        std::vector<uint32_t> out;
+        for (const auto *entry: entries) {
+            out.push_back(entry->id);
+        }
+        return out;
+    }
+}
+
+DROGON_TEST(PrefixIndexTest)
+{
+    CHECK(PrefixIndex::normalize("  Apple iPhone-15 ") == "apple iphone 15");
+
+    PrefixIndex empty;
+    CHECK(empty.suggest("a", 5).empty());
+
+    PrefixIndex index({{1, "Apple iPhone 15", 10},
+                       {2, "Apple Watch", 30},
+                       {3, "Red red apple", 20},
+                       {4, "Pineapple", 99},
+                       {5, "apple pie", 20}},
+                      3);
+    CHECK(index.size() == 5);
+
+    // title starts and word starts, best score first, ties to the newer id, capped at K
+    CHECK(ids(index.suggest("app", 10)) == std::vector<uint32_t>({2, 5, 3}));
+    CHECK(ids(index.suggest("APPLE W", 10)) == std::vector<uint32_t>({2}));
+    CHECK(ids(index.suggest("iph", 10)) == std::vector<uint32_t>({1}));
+    CHECK(ids(index.suggest("red", 10)) == std::vector<uint32_t>({3}));
+    CHECK(ids(index.suggest("app", 1)) == std::vector<uint32_t>({2}));
+    CHECK(index.suggest("xyz", 10).empty());
+    CHECK(index.suggest(" - ", 10).empty());
+    // not a word start
+    CHECK(index.suggest("ineapple", 10).empty());
+
+    // beyond kMaxDepth the candidates are filtered on the whole prefix
+    std::string longTitle(PrefixIndex::kMaxDepth, 'a');
+    PrefixIndex deep({{1, longTitle + "b", 1}, {2, longTitle + "c", 2}}, 4);
+    CHECK(ids(deep.suggest(longTitle, 10)) == std::vector<uint32_t>({2, 1}));
+    CHECK(ids(deep.suggest(longTitle + "b", 10)) == std::vector<uint32_t>({1}));
+}
@@ -0,0 +1,53 @@
+#include <drogon/drogon_test.h>
+#include "../tools/rcu_snapshot.h"
+#include <thread>
+#include <vector>
+
+DROGON_TEST(RcuSnapshotTest)
+{
+    RcuSnapshot<int> snapshot;
+    CHECK(snapshot.load() == nullptr);
+
+    snapshot.publish(std::make_shared<const int>(1));
+    std::weak_ptr<const int> first = snapshot.load();
+    CHECK(*snapshot.load() == 1);
+
+    snapshot.publish(std::make_shared<const int>(2));
+    CHECK(*snapshot.load() == 2);
+    // this thread has moved on, nothing else holds the old version
+    CHECK(first.expired());
+    CHECK(snapshot.publishes() == 2);
+
+    // a second instance of the same type is never confused with the first
+    RcuSnapshot<int> other;
+    CHECK(other.load() == nullptr);
+    other.publish(std::make_shared<const int>(7));
+    CHECK(*other.load() == 7);
+    CHECK(*snapshot.load() == 2);
+
+    // readers only ever see published values, in publish order
+    std::atomic<bool> done{false};
+    std::atomic<bool> ordered{true};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&]() {
+            int last = 0;
+            while (!done.load()) {
+                int seen = *snapshot.load();
+                if (seen < last) {
+                    ordered = false;
+                }
+                last = seen;
+            }
+        });
+    }
+    for (int i = 3; i <= 2000; ++i) {
+        snapshot.publish(std::make_shared<const int>(i));
+    }
+    done = true;
+    for (auto &reader: readers) {
+        reader.join();
+    }
+    CHECK(ordered.load());
+    CHECK(*snapshot.load() == 2000);
+}
@@ -0,0 +1,73 @@
+#include <drogon/drogon_test.h>
+#include "../tools/single_flight.h"
+#include <stdexcept>
+#include <string>
+
+DROGON_TEST(SingleFlightTest)
+{
+    SingleFlight<int, std::string> flight;
+    std::function<void(const std::string &)> pending;
+    int fetches = 0;
+    std::vector<std::string> seen;
+
+    auto fetch = [&](std::function<void(const std::string &)> resolve) {
+        ++fetches;
+        pending = std::move(resolve);
+    };
+    for (int i = 0; i < 3; ++i) {
+        flight.run(7, [&](const std::string &v) { seen.push_back(v); }, fetch);
+    }
+    CHECK(fetches == 1);
+    CHECK(flight.inFlight() == 1);
+    CHECK(flight.joined() == 2);
+
+    pending("row");
+    CHECK(seen.size() == 3);
+    CHECK(seen[2] == "row");
+    CHECK(flight.inFlight() == 0);
+
+    // once resolved, the next call starts a fresh fetch
+    flight.run(7, [&](const std::string &v) { seen.push_back(v); }, fetch);
+    CHECK(fetches == 2);
+    CHECK(flight.led() == 2);
+}
+
+DROGON_TEST(SingleFlightThrowTest)
+{
+    SingleFlight<int, std::string> flight;
+    std::vector<std::string> seen;
+    auto waiter = [&](const std::string &v) { seen.push_back(v); };
+
+    // a fetch that throws before resolving fails its waiter and releases the key
+    flight.run(7, waiter, [](auto) { throw std::runtime_error("no connection"); },
+               [](std::exception_ptr error) {
+                   try {
+                       std::rethrow_exception(error);
+                   } catch (const std::exception &e) {
+                       return std::string("failed: ") + e.what();
+                   }
+               });
+    CHECK(seen == std::vector<std::string>{"failed: no connection"});
+    CHECK(flight.inFlight() == 0);
+
+    // without fail the waiters get an empty value; the next call fetches again
+    flight.run(7, waiter, [](auto) { throw std::runtime_error("again"); });
+    CHECK(seen.size() == 2);
+    CHECK(seen[1].empty());
+    int fetches = 0;
+    flight.run(7, waiter, [&](auto resolve) {
+        ++fetches;
+        resolve("row");
+    });
+    CHECK(fetches == 1);
+    CHECK(seen.back() == "row");
+
+    // an exception thrown after resolving is not swallowed
+    CHECK_THROWS_AS(flight.run(8, waiter,
+                               [](auto resolve) {
+                                   resolve("row");
+                                   throw std::logic_error("late");
+                               }),
+                    std::logic_error);
+    CHECK(flight.inFlight() == 0);
+}
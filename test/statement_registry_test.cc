@@ -0,0 +1,33 @@
+#include <drogon/drogon_test.h>
+#include "../tools/statement_registry.h"
+#include <stdexcept>
+#include <string>
+
+DROGON_TEST(StatementRegistryTest)
+{
+    auto &registry = StatementRegistry::instance();
+    auto before = registry.size();
+
+    const auto &first = registry.add("test.by_id", "select * from t where id = $1");
+    CHECK(first.name == "test.by_id");
+    CHECK(registry.size() == before + 1);
+
+    // re-registering the same text hands back the same entry
+    const auto &again = registry.add("test.by_id", "select * from t where id = $1");
+    CHECK(&again == &first);
+    CHECK(&registry.get("test.by_id") == &first);
+    CHECK_THROWS_AS(registry.add("test.by_id", "select 1"), std::logic_error);
+    CHECK_THROWS_AS(registry.get("test.missing"), std::out_of_range);
+
+    // lazily built variants are built once
+    int builds = 0;
+    auto build = [&builds]() {
+        ++builds;
+        return std::string("select id from t where id = $1");
+    };
+    const auto &lazy = registry.getOrAdd("test.by_id(id)", build);
+    CHECK(&registry.getOrAdd("test.by_id(id)", build) == &lazy);
+    CHECK(builds == 1);
+    CHECK(lazy.sql == "select id from t where id = $1");
+    CHECK(!lazy.bindWarmUpArgs);
+}
@@ -0,0 +1,56 @@
+#include <drogon/drogon_test.h>
+#include "../tools/stock_counter.h"
+
+DROGON_TEST(StockCounterTest)
+{
+    StockCounter stock(10);
+    CHECK(!stock.reserve(1).has_value());
+
+    // the first lease asks for a block and the row had 8 left
+    CHECK(stock.beginTransfer() == 10);
+    CHECK(!stock.beginTransfer().has_value()); // one transfer at a time
+    stock.transferred(8);
+    CHECK(stock.ready());
+    CHECK(stock.reserve(4) == 4);
+    CHECK(stock.reserve(7) == std::nullopt);
+
+    // below half a block, and a reservation of 7 was refused: enough is leased to cover it
+    CHECK(stock.beginTransfer() == 10);
+    stock.transferred(10);
+    CHECK(stock.reserve(7) == 7);
+    CHECK(!stock.beginTransfer().has_value()); // within bounds
+
+    // releases past two blocks go back to the row, keeping one
+    CHECK(stock.release(20) == 27);
+    CHECK(stock.beginTransfer() == -17);
+    CHECK(stock.available() == 10);
+    stock.transferred(0);
+    CHECK(stock.available() == 10);
+    CHECK(!stock.beginTransfer().has_value());
+}
+
+DROGON_TEST(StockCounterFailureTest)
+{
+    StockCounter stock(10);
+
+    // a lease that failed is taken as not granted, and the counter stays unready
+    CHECK(stock.beginTransfer() == 10);
+    stock.transferFailed();
+    CHECK(!stock.ready());
+    CHECK(stock.beginTransfer() == 10);
+    stock.transferred(10);
+    CHECK(stock.available() == 10);
+
+    // a give-back that failed is taken as done: the units are not sold again
+    stock.release(15);
+    CHECK(stock.beginTransfer() == -15);
+    stock.transferFailed();
+    CHECK(stock.available() == 10);
+
+    // a lease the row could not fill at all still makes the counter ready, with nothing to sell
+    StockCounter empty(10);
+    CHECK(empty.beginTransfer() == 10);
+    empty.transferred(0);
+    CHECK(empty.ready());
+    CHECK(!empty.reserve(1).has_value());
+}
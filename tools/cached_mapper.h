@@ -0,0 +1,155 @@
+#pragma once
+#include <drogon/orm/CoroMapper.h>
+#include <drogon/orm/Mapper.h>
+#include <drogon/utils/coroutine.h>
+#include "lru_cache.h"
+#include <chrono>
+#include <functional>
+#include <optional>
+
+// Read-through cache in front of drogon::orm::Mapper<T>, keyed on T::PrimaryKeyType.
+// Every model type gets one process-wide cache; the write methods below evict the row they touch,
+// writes that bypass the mapper must call invalidate() themselves.
+template<typename T>
+class CachedMapper {
+public:
+    using Key = typename T::PrimaryKeyType;
+    using Cache = ShardedLruCache<Key, T>;
+    using SingleRowCallback = std::function<void(const T &)>;
+    using CountCallback = std::function<void(size_t)>;
+    using ExceptionCallback = std::function<void(const drogon::orm::DrogonDbException &)>;
+
+    explicit CachedMapper(drogon::orm::DbClientPtr client) : client_(std::move(client)) {
+    }
+
+    // Size and TTL of the cache; only honoured when called before the first lookup (see main.cc)
+    static void configure(size_t capacity, std::chrono::milliseconds ttl) {
+        options().capacity = capacity;
+        options().ttl = ttl;
+    }
+
+    static Cache &cache() {
+        static Cache instance(options().capacity, options().ttl);
+        return instance;
+    }
+
+    static void invalidate(const Key &key) {
+        cache().erase(key);
+    }
+
+    static std::optional<T> findCached(const Key &key) {
+        return cache().get(key);
+    }
+
+    void findByPrimaryKey(const Key &key, SingleRowCallback &&rcb, ExceptionCallback &&ecb) {
+        if (auto hit = cache().get(key)) {
+            rcb(*hit);
+            return;
+        }
+        auto generation = cache().generation(key);
+        drogon::orm::Mapper<T>(client_).findByPrimaryKey(
+            key,
+            [key, generation, rcb = std::move(rcb)](T row) {
+                cache().put(key, row, generation);
+                rcb(row);
+            },
+            std::move(ecb));
+    }
+
+    void insert(const T &obj, SingleRowCallback &&rcb, ExceptionCallback &&ecb) {
+        drogon::orm::Mapper<T>(client_).insert(
+            obj,
+            [rcb = std::move(rcb)](T row) {
+                invalidate(row.getPrimaryKey());
+                rcb(row);
+            },
+            std::move(ecb));
+    }
+
+    void update(const T &obj, CountCallback &&rcb, ExceptionCallback &&ecb) {
+        auto key = obj.getPrimaryKey();
+        drogon::orm::Mapper<T>(client_).update(
+            obj,
+            [key, rcb = std::move(rcb)](const size_t count) {
+                invalidate(key);
+                rcb(count);
+            },
+            [key, ecb = std::move(ecb)](const drogon::orm::DrogonDbException &e) {
+                invalidate(key);
+                ecb(e);
+            });
+    }
+
+    void deleteByPrimaryKey(const Key &key, CountCallback &&rcb, ExceptionCallback &&ecb) {
+        drogon::orm::Mapper<T>(client_).deleteByPrimaryKey(
+            key,
+            [key, rcb = std::move(rcb)](const size_t count) {
+                invalidate(key);
+                rcb(count);
+            },
+            [key, ecb = std::move(ecb)](const drogon::orm::DrogonDbException &e) {
+                invalidate(key);
+                ecb(e);
+            });
+    }
+
+    // Coroutine flavours, named after DbClient::execSqlCoro; they throw like CoroMapper does
+    drogon::Task<T> findByPrimaryKeyCoro(Key key) {
+        auto client = client_;
+        if (auto hit = cache().get(key)) {
+            co_return *hit;
+        }
+        auto generation = cache().generation(key);
+        T row = co_await drogon::orm::CoroMapper<T>(client).findByPrimaryKey(key);
+        cache().put(key, row, generation);
+        co_return row;
+    }
+
+    drogon::Task<T> insertCoro(T obj) {
+        auto client = client_;
+        T row = co_await drogon::orm::CoroMapper<T>(client).insert(obj);
+        invalidate(row.getPrimaryKey());
+        co_return row;
+    }
+
+    drogon::Task<size_t> updateCoro(T obj) {
+        auto client = client_;
+        auto key = obj.getPrimaryKey();
+        size_t count = 0;
+        try {
+            count = co_await drogon::orm::CoroMapper<T>(client).update(obj);
+        } catch (...) {
+            // a failed round trip (e.g. a timeout) may still have committed
+            invalidate(key);
+            throw;
+        }
+        invalidate(key);
+        co_return count;
+    }
+
+    drogon::Task<size_t> deleteByPrimaryKeyCoro(Key key) {
+        auto client = client_;
+        size_t count = 0;
+        try {
+            count = co_await drogon::orm::CoroMapper<T>(client).deleteByPrimaryKey(key);
+        } catch (...) {
+            invalidate(key);
+            throw;
+        }
+        invalidate(key);
+        co_return count;
+    }
+
+private:
+    struct Options {
+        size_t capacity = 10000;
+        std::chrono::milliseconds ttl = std::chrono::seconds(60);
+    };
+
+    static Options &options() {
+        static Options instance;
+        return instance;
+    }
+
+    drogon::orm::DbClientPtr client_;
+};
@@ -0,0 +1,186 @@
+#include "catalog_columns.h"
+#include <algorithm>
+#include <limits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+CatalogColumns CatalogColumns::merged(const CatalogColumns &base, const CatalogColumns &changes,
+                                     const std::vector<int32_t> &removed) {
+    CatalogColumns out;
+    out.reserve(base.size() + changes.size());
+    out.arena_.reserve(base.arena_.size() + changes.arena_.size());
+    uint32_t b = 0, c = 0;
+    while (b < base.size() || c < changes.size()) {
+        if (c < changes.size() && (b == base.size() || changes.ids_[c] <= base.ids_[b])) {
+            // a changed row replaces the base row with its id
+            if (b < base.size() && base.ids_[b] == changes.ids_[c]) {
+                ++b;
+            }
+            out.appendRow(changes, c++);
+            continue;
+        }
+        if (!std::binary_search(removed.begin(), removed.end(), base.ids_[b])) {
+            out.appendRow(base, b);
+        }
+        ++b;
+    }
+    return out;
+}
+
+void CatalogColumns::appendRow(const CatalogColumns &from, uint32_t row) {
+    append(from.ids_[row], from.prices_[row], from.quantities_[row], from.createdAt_[row], from.versions_[row],
+           from.title(row), from.description(row), from.image(row));
+}
+
+std::optional<uint32_t> CatalogColumns::find(int32_t id) const {
+    auto it = std::lower_bound(ids_.begin(), ids_.end(), id);
+    if (it == ids_.end() || *it != id) {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(it - ids_.begin());
+}
+
+void CatalogColumns::reserve(size_t rows) {
+    ids_.reserve(rows);
+    prices_.reserve(rows);
+    quantities_.reserve(rows);
+    createdAt_.reserve(rows);
+    versions_.reserve(rows);
+    for (auto *column: {&titles_, &descriptions_, &images_}) {
+        column->offsets.reserve(rows);
+        column->lengths.reserve(rows);
+    }
+}
+
+void CatalogColumns::append(int32_t id, double price, int32_t quantity, int64_t createdAt, int64_t version,
+                            std::optional<std::string_view> title, std::optional<std::string_view> description,
+                            std::optional<std::string_view> image) {
+    ids_.push_back(id);
+    prices_.push_back(price);
+    quantities_.push_back(quantity);
+    createdAt_.push_back(createdAt);
+    versions_.push_back(version);
+    appendText(titles_, title);
+    appendText(descriptions_, description);
+    appendText(images_, image);
+}
+
+void CatalogColumns::appendText(TextColumn &column, std::optional<std::string_view> value) {
+    column.offsets.push_back(arena_.size());
+    if (!value) {
+        column.lengths.push_back(kNull);
+        return;
+    }
+    auto length = std::min<size_t>(value->size(), kNull - 1);
+    column.lengths.push_back(static_cast<uint32_t>(length));
+    arena_.append(value->data(), length);
+}
+
+std::optional<std::string_view> CatalogColumns::text(const TextColumn &column, uint32_t row) const {
+    if (column.lengths[row] == kNull) {
+        return std::nullopt;
+    }
+    return std::string_view(arena_).substr(column.offsets[row], column.lengths[row]);
+}
+
+std::vector<uint32_t> CatalogColumns::select(const Filter &filter) const {
+    std::vector<uint32_t> out;
+    const size_t n = size();
+    bool priceBound = filter.minPrice || filter.maxPrice;
+    // NaN (NULL) fails both compares, so any bound drops products without a price
+    double lo = filter.minPrice.value_or(-std::numeric_limits<double>::infinity());
+    double hi = filter.maxPrice.value_or(std::numeric_limits<double>::infinity());
+    if (!priceBound && !filter.inStock) {
+        out.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = static_cast<uint32_t>(i);
+        }
+        return out;
+    }
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    // four rows per step: two double compares for the price, one int32 compare for the quantity, folded
+    // into a 4-bit mask of the rows that pass
+    const __m128d vlo = _mm_set1_pd(lo);
+    const __m128d vhi = _mm_set1_pd(hi);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        int mask = 0xf;
+        if (priceBound) {
+            __m128d a = _mm_loadu_pd(prices_.data() + i);
+            __m128d b = _mm_loadu_pd(prices_.data() + i + 2);
+            int ma = _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(a, vlo), _mm_cmple_pd(a, vhi)));
+            int mb = _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(b, vlo), _mm_cmple_pd(b, vhi)));
+            mask &= ma | (mb << 2);
+        }
+        if (filter.inStock) {
+            __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i *>(quantities_.data() + i));
+            mask &= _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(q, zero)));
+        }
+        while (mask) {
+            out.push_back(static_cast<uint32_t>(i + __builtin_ctz(static_cast<unsigned>(mask))));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        if (priceBound && !(prices_[i] >= lo && prices_[i] <= hi)) {
+            continue;
+        }
+        if (filter.inStock && quantities_[i] <= 0) {
+            continue;
+        }
+        out.push_back(static_cast<uint32_t>(i));
+    }
+    return out;
+}
+
+CatalogColumns::Key CatalogColumns::key(uint32_t row, Order order) const {
+    if (order == Order::Newest) {
+        // microseconds stay exact in a double until the year 2255
+        return {static_cast<double>(createdAt_[row]), ids_[row]};
+    }
+    return {prices_[row], ids_[row]};
+}
+
+std::vector<uint32_t> CatalogColumns::top(const Filter &filter, Order order, size_t limit,
+                                          std::optional<Key> after) const {
+    auto effective = filter;
+    if (order != Order::Newest && !effective.minPrice && !effective.maxPrice) {
+        // an unbounded price range still drops the NaNs, which have no place in a price order
+        effective.minPrice = -std::numeric_limits<double>::infinity();
+    }
+    auto rows = select(effective);
+
+    // a before b in order
+    auto before = [order](const Key &a, const Key &b) {
+        switch (order) {
+            case Order::PriceAsc:
+                return a.value != b.value ? a.value < b.value : a.id < b.id;
+            default:
+                return a.value != b.value ? a.value > b.value : a.id > b.id;
+        }
+    };
+    if (after) {
+        rows.erase(std::remove_if(rows.begin(), rows.end(),
+                                  [&](uint32_t row) { return !before(*after, key(row, order)); }),
+                   rows.end());
+    }
+    auto middle = rows.begin() + static_cast<std::ptrdiff_t>(std::min(limit, rows.size()));
+    std::partial_sort(rows.begin(), middle, rows.end(),
+                      [&](uint32_t a, uint32_t b) { return before(key(a, order), key(b, order)); });
+    rows.erase(middle, rows.end());
+    return rows;
+}
+
+size_t CatalogColumns::bytes() const {
+    size_t total = arena_.capacity() + ids_.capacity() * sizeof(int32_t) + prices_.capacity() * sizeof(double) +
+                   quantities_.capacity() * sizeof(int32_t) + createdAt_.capacity() * sizeof(int64_t) +
+                   versions_.capacity() * sizeof(int64_t);
+    for (const auto *column: {&titles_, &descriptions_, &images_}) {
+        total += column->offsets.capacity() * sizeof(uint64_t) + column->lengths.capacity() * sizeof(uint32_t);
+    }
+    return total;
+}
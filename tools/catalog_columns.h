@@ -0,0 +1,119 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Structure-of-arrays copy of the product catalog for filtered and sorted listings. Numeric columns sit in
+// their own contiguous arrays, so a filter streams through just the columns it tests, several rows per
+// SIMD compare; the text columns share one arena and are only touched for the rows of the page.
+// Rows are appended in ascending id order and never changed; a changed catalog is a new CatalogColumns made
+// by merging the changed rows into the old one. SQL NULLs are a NaN price or a std::nullopt text.
+class CatalogColumns {
+public:
+    enum class Order {
+        Newest,   // created_at desc, id desc
+        PriceAsc, // price asc, id asc
+        PriceDesc // price desc, id desc
+    };
+
+    struct Filter {
+        std::optional<double> minPrice; // inclusive
+        std::optional<double> maxPrice; // inclusive
+        bool inStock = false;           // quantity > 0
+    };
+
+    // A row's position in an order: the price, or created_at in microseconds, and the id
+    struct Key {
+        double value = 0;
+        int32_t id = 0;
+    };
+
+    // base without the ids in changes or removed, plus the rows of changes; both inputs sorted by id.
+    // Copies every column of base, so a merge costs the catalog's size, not the number of changes
+    static CatalogColumns merged(const CatalogColumns &base, const CatalogColumns &changes,
+                                 const std::vector<int32_t> &removed);
+
+    void reserve(size_t rows);
+
+    void append(int32_t id, double price, int32_t quantity, int64_t createdAt, int64_t version,
+                std::optional<std::string_view> title, std::optional<std::string_view> description,
+                std::optional<std::string_view> image);
+
+    size_t size() const {
+        return ids_.size();
+    }
+
+    // Row holding id, by binary search over the id column
+    std::optional<uint32_t> find(int32_t id) const;
+
+    // Rows passing filter, ascending; a price bound never matches a NULL price
+    std::vector<uint32_t> select(const Filter &filter) const;
+
+    // The first limit rows in order that pass filter and come after `after`. Sorting by price leaves out
+    // products without one.
+    std::vector<uint32_t> top(const Filter &filter, Order order, size_t limit,
+                              std::optional<Key> after = std::nullopt) const;
+
+    Key key(uint32_t row, Order order) const;
+
+    int32_t id(uint32_t row) const {
+        return ids_[row];
+    }
+
+    double price(uint32_t row) const {
+        return prices_[row];
+    }
+
+    int32_t quantity(uint32_t row) const {
+        return quantities_[row];
+    }
+
+    // microseconds since the epoch
+    int64_t createdAt(uint32_t row) const {
+        return createdAt_[row];
+    }
+
+    int64_t version(uint32_t row) const {
+        return versions_[row];
+    }
+
+    std::optional<std::string_view> title(uint32_t row) const {
+        return text(titles_, row);
+    }
+
+    std::optional<std::string_view> description(uint32_t row) const {
+        return text(descriptions_, row);
+    }
+
+    std::optional<std::string_view> image(uint32_t row) const {
+        return text(images_, row);
+    }
+
+    size_t bytes() const;
+
+private:
+    // [offset, offset + length) of the arena; length kNull for NULL
+    struct TextColumn {
+        std::vector<uint64_t> offsets;
+        std::vector<uint32_t> lengths;
+    };
+
+    static constexpr uint32_t kNull = UINT32_MAX;
+
+    void appendRow(const CatalogColumns &from, uint32_t row);
+    void appendText(TextColumn &column, std::optional<std::string_view> value);
+    std::optional<std::string_view> text(const TextColumn &column, uint32_t row) const;
+
+    std::vector<int32_t> ids_;
+    std::vector<double> prices_;
+    std::vector<int32_t> quantities_;
+    std::vector<int64_t> createdAt_;
+    std::vector<int64_t> versions_;
+    TextColumn titles_;
+    TextColumn descriptions_;
+    TextColumn images_;
+    std::string arena_;
+};
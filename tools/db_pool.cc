@@ -0,0 +1,236 @@
+#include "db_pool.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <optional>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+    double p95Ms(const LatencyWindow &window) {
+        return static_cast<double>(window.percentile().value_or(0)) / 1000.0;
+    }
+}
+
+void DbPool::Histogram::record(std::chrono::microseconds elapsed) {
+    auto ms = static_cast<double>(elapsed.count()) / 1000.0;
+    auto bucket = std::lower_bound(boundsMs.begin(), boundsMs.end(), ms) - boundsMs.begin();
+    counts_[static_cast<size_t>(bucket)].fetch_add(1, std::memory_order_relaxed);
+}
+
+Json::Value DbPool::Histogram::toJson() const {
+    Json::Value buckets(Json::arrayValue);
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        Json::Value bucket;
+        bucket["le_ms"] = i < boundsMs.size() ? Json::Value(boundsMs[i]) : Json::Value("inf");
+        bucket["count"] = static_cast<Json::UInt64>(counts_[i].load(std::memory_order_relaxed));
+        buckets.append(bucket);
+    }
+    return buckets;
+}
+
+DbPool::DbPool(const Options &options) : options_(options), scaler_(options.scaling) {
+}
+
+void DbPool::start() {
+    adjust();
+    auto *loop = app().getLoop();
+    // timeouts are checked at a finer grain than the pool is resized
+    auto expireEvery = std::clamp(static_cast<double>(options_.acquireTimeout.count()) / 4000.0, 0.01, 0.1);
+    loop->runEvery(expireEvery, [this]() { expireWaiters(); });
+    loop->runEvery(options_.scaleInterval, [this]() { adjust(); });
+}
+
+void DbPool::execute(Query query, ResultCallback rcb, ExceptionCallback ecb) {
+    Waiter waiter{std::move(query), std::move(rcb), std::move(ecb), Clock::now()};
+    std::shared_ptr<Connection> idle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(connections_.begin(), connections_.end(),
+                               [](const auto &connection) { return !connection->busy; });
+        if (it == connections_.end()) {
+            waiting_.push_back(std::move(waiter));
+            peakWaiting_ = std::max(peakWaiting_, waiting_.size());
+            return;
+        }
+        idle = *it;
+        idle->busy = true;
+        peakInUse_ = std::max(peakInUse_, ++inUse_);
+    }
+    run(idle, std::move(waiter));
+}
+
+// called without mutex_ held, with connection marked busy
+void DbPool::run(const std::shared_ptr<Connection> &connection, Waiter waiter) {
+    auto started = Clock::now();
+    auto waited = std::chrono::duration_cast<std::chrono::microseconds>(started - waiter.queued);
+    waits_.record(static_cast<uint64_t>(waited.count()));
+    waitHistogram_.record(waited);
+    executed_.fetch_add(1, std::memory_order_relaxed);
+    // the connection goes back exactly once, whether the query answers or throws before it is sent
+    auto completed = std::make_shared<std::atomic<bool>>(false);
+    auto ecb = std::make_shared<ExceptionCallback>(std::move(waiter.ecb));
+    auto fail = [this, connection, started, completed, ecb](const DrogonDbException &e) {
+        if (completed->exchange(true)) {
+            return false;
+        }
+        finish(connection, started);
+        (*ecb)(e);
+        return true;
+    };
+    // an exception after the answer came out of the caller's own callback and is passed on
+    try {
+        waiter.query(
+            connection->client,
+            [this, connection, started, completed, rcb = std::move(waiter.rcb)](const Result &r) {
+                if (completed->exchange(true)) {
+                    return;
+                }
+                finish(connection, started);
+                rcb(r);
+            },
+            [fail](const DrogonDbException &e) { fail(e); });
+    } catch (const DrogonDbException &e) {
+        if (!fail(e)) {
+            throw;
+        }
+    } catch (const std::exception &e) {
+        if (!fail(Failure(e.what()))) {
+            throw;
+        }
+    }
+}
+
+// hands the connection straight to the oldest waiter, if any
+void DbPool::finish(const std::shared_ptr<Connection> &connection, Clock::time_point started) {
+    auto took = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started);
+    queries_.record(static_cast<uint64_t>(took.count()));
+    queryHistogram_.record(took);
+
+    std::optional<Waiter> next;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (waiting_.empty()) {
+            connection->busy = false;
+            --inUse_;
+        } else {
+            next = std::move(waiting_.front());
+            waiting_.pop_front();
+        }
+    }
+    if (next) {
+        run(connection, std::move(*next));
+    }
+}
+
+// pairs idle connections with queued queries, after the pool has grown
+void DbPool::drain() {
+    while (true) {
+        std::shared_ptr<Connection> idle;
+        std::optional<Waiter> next;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (waiting_.empty()) {
+                return;
+            }
+            auto it = std::find_if(connections_.begin(), connections_.end(),
+                                   [](const auto &connection) { return !connection->busy; });
+            if (it == connections_.end()) {
+                return;
+            }
+            idle = *it;
+            idle->busy = true;
+            peakInUse_ = std::max(peakInUse_, ++inUse_);
+            next = std::move(waiting_.front());
+            waiting_.pop_front();
+        }
+        run(idle, std::move(*next));
+    }
+}
+
+void DbPool::expireWaiters() {
+    std::vector<Waiter> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto deadline = Clock::now() - options_.acquireTimeout;
+        // FIFO: everything that waited too long is at the front
+        while (!waiting_.empty() && waiting_.front().queued <= deadline) {
+            expired.push_back(std::move(waiting_.front()));
+            waiting_.pop_front();
+        }
+    }
+    for (auto &waiter: expired) {
+        timeouts_.fetch_add(1, std::memory_order_relaxed);
+        waitHistogram_.record(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - waiter.queued));
+        waiter.ecb(TimeoutError("Timed out waiting for a database connection"));
+    }
+}
+
+void DbPool::adjust() {
+    PoolScaler::Sample sample;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sample.size = connections_.size();
+        sample.peakInUse = peakInUse_;
+        sample.peakWaiting = peakWaiting_;
+        peakInUse_ = inUse_;
+        peakWaiting_ = waiting_.size();
+    }
+    sample.waitP95Ms = p95Ms(waits_);
+    sample.queryP95Ms = p95Ms(queries_);
+
+    auto change = scaler_.decide(sample);
+    if (change > 0) {
+        // clients connect in the background; queries handed to them meanwhile wait inside drogon
+        std::vector<std::shared_ptr<Connection>> added;
+        for (int i = 0; i < change; ++i) {
+            auto connection = std::make_shared<Connection>();
+            connection->client = DbClient::newPgClient(options_.connectionInfo, 1);
+            added.push_back(std::move(connection));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            connections_.insert(connections_.end(), added.begin(), added.end());
+        }
+        opened_.fetch_add(static_cast<uint64_t>(change), std::memory_order_relaxed);
+        LOG_DEBUG << "db pool grew to " << sample.size + static_cast<size_t>(change) << " connections";
+        drain();
+    } else if (change < 0) {
+        // only idle connections are closed, so no query is cut off; the client is destroyed outside the lock
+        std::vector<std::shared_ptr<Connection>> removed;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = connections_.size(); i > 0 && removed.size() < static_cast<size_t>(-change); --i) {
+                if (!connections_[i - 1]->busy) {
+                    removed.push_back(connections_[i - 1]);
+                    connections_.erase(connections_.begin() + static_cast<std::ptrdiff_t>(i - 1));
+                }
+            }
+        }
+        closed_.fetch_add(removed.size(), std::memory_order_relaxed);
+        LOG_DEBUG << "db pool closed " << removed.size() << " idle connection(s)";
+    }
+}
+
+Json::Value DbPool::stats() const {
+    Json::Value stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats["size"] = static_cast<Json::UInt64>(connections_.size());
+        stats["in_use"] = static_cast<Json::UInt64>(inUse_);
+        stats["waiting"] = static_cast<Json::UInt64>(waiting_.size());
+    }
+    stats["min_size"] = static_cast<Json::UInt64>(scaler_.options().minSize);
+    stats["max_size"] = static_cast<Json::UInt64>(scaler_.options().maxSize);
+    stats["executed"] = static_cast<Json::UInt64>(executed_.load(std::memory_order_relaxed));
+    stats["timeouts"] = static_cast<Json::UInt64>(timeouts_.load(std::memory_order_relaxed));
+    stats["opened"] = static_cast<Json::UInt64>(opened_.load(std::memory_order_relaxed));
+    stats["closed"] = static_cast<Json::UInt64>(closed_.load(std::memory_order_relaxed));
+    stats["wait_p95_ms"] = p95Ms(waits_);
+    stats["query_p95_ms"] = p95Ms(queries_);
+    stats["wait_ms"] = waitHistogram_.toJson();
+    stats["query_ms"] = queryHistogram_.toJson();
+    return stats;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <drogon/orm/DbClient.h>
+#include <json/json.h>
+#include "latency_window.h"
+#include "pool_scaler.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Connection pool to one PostgreSQL server that resizes itself between custom_config.db_pool bounds.
+// drogon fixes number_of_connections when a client is created, so every pooled connection is a client of
+// its own and the pool hands each query to an idle one. Queries wait in a FIFO queue while every connection
+// is busy; PoolScaler sizes the pool from that queue and from query times, and a query that waits longer
+// than acquire_timeout_ms fails with a TimeoutError.
+class DbPool {
+public:
+    using Query = std::function<void(const drogon::orm::DbClientPtr &, drogon::orm::ResultCallback &&,
+                                     drogon::orm::ExceptionCallback &&)>;
+
+    struct Options {
+        std::string connectionInfo;
+        PoolScaler::Options scaling;
+        std::chrono::milliseconds acquireTimeout{2000};
+        double scaleInterval = 0.5; // seconds
+    };
+
+    explicit DbPool(const Options &options);
+
+    // Opens the minimum number of connections and starts the scaling timer; call from a beginning advice
+    void start();
+
+    // Runs query on a connection of its own; rcb/ecb get whatever the query passes on
+    void execute(Query query, drogon::orm::ResultCallback rcb, drogon::orm::ExceptionCallback ecb);
+
+    Json::Value stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Connection {
+        drogon::orm::DbClientPtr client;
+        bool busy = false;
+    };
+
+    struct Waiter {
+        Query query;
+        drogon::orm::ResultCallback rcb;
+        drogon::orm::ExceptionCallback ecb;
+        Clock::time_point queued;
+    };
+
+    // Counts of samples per upper bound in milliseconds; the last bucket takes everything slower
+    class Histogram {
+    public:
+        void record(std::chrono::microseconds elapsed);
+        Json::Value toJson() const;
+
+    private:
+        static constexpr std::array<double, 10> boundsMs{1, 2, 5, 10, 25, 50, 100, 250, 500, 1000};
+        std::array<std::atomic<uint64_t>, boundsMs.size() + 1> counts_{};
+    };
+
+    void run(const std::shared_ptr<Connection> &connection, Waiter waiter);
+    void finish(const std::shared_ptr<Connection> &connection, Clock::time_point started);
+    void drain();
+    void expireWaiters();
+    void adjust();
+
+    Options options_;
+    PoolScaler scaler_;
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<Connection>> connections_;
+    std::deque<Waiter> waiting_;
+    size_t inUse_ = 0;
+    size_t peakInUse_ = 0;   // since the last adjust()
+    size_t peakWaiting_ = 0; // since the last adjust()
+    LatencyWindow waits_{1024, 95.0, 16};
+    LatencyWindow queries_{1024, 95.0, 16};
+    Histogram waitHistogram_;
+    Histogram queryHistogram_;
+    std::atomic<uint64_t> executed_{0};
+    std::atomic<uint64_t> timeouts_{0};
+    std::atomic<uint64_t> opened_{0};
+    std::atomic<uint64_t> closed_{0};
+};
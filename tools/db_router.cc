@@ -0,0 +1,428 @@
+#include "db_router.h"
+#include "pg_lsn.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+#include <chrono>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+    int64_t steadyNowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // a standby reports what it has replayed; a server that is not in recovery reports its own position
+    const std::string &sqlForReplayedLsn() {
+        static const std::string sql = "select (case when pg_is_in_recovery() then pg_last_wal_replay_lsn()"
+                                       " else pg_current_wal_lsn() end)::text";
+        return sql;
+    }
+
+    const std::string &sqlForCurrentLsn() {
+        static const std::string sql = "select pg_current_wal_lsn()::text";
+        return sql;
+    }
+}
+
+DbRouter &DbRouter::instance() {
+    static DbRouter router;
+    return router;
+}
+
+void DbRouter::configure(const Json::Value &config) {
+    primaryName_ = config.get("primary", "default").asString();
+    tokenHeader_ = config.get("token_header", "X-Read-After").asString();
+    pollInterval_ = config.get("poll_interval_ms", 100).asDouble() / 1000.0;
+    maxStalenessMs_ = config.get("max_staleness_ms", 1000).asInt64();
+    const auto &hedging = config["hedging"];
+    hedging_.enabled = hedging.get("enabled", false).asBool();
+    hedging_.minDelay = std::chrono::microseconds(hedging.get("min_delay_ms", 2).asInt64() * 1000);
+    hedging_.maxDelay = std::chrono::microseconds(hedging.get("max_delay_ms", 100).asInt64() * 1000);
+    hedging_.initialDelay = std::chrono::microseconds(hedging.get("initial_delay_ms", 10).asInt64() * 1000);
+    hedging_.latencies = std::make_unique<LatencyWindow>(hedging.get("window", 1024).asUInt64(),
+                                                         hedging.get("percentile", 95.0).asDouble());
+    replicas_.clear();
+    for (const auto &name: config["replicas"]) {
+        auto replica = std::make_unique<Replica>();
+        replica->name = name.asString();
+        replicas_.push_back(std::move(replica));
+    }
+}
+
+std::string DbRouter::connectionInfo(const Json::Value &dbClient) {
+    std::string info;
+    for (auto [key, option]: {std::pair{"host", "host"}, std::pair{"port", "port"}, std::pair{"dbname", "dbname"},
+                              std::pair{"user", "user"}, std::pair{"passwd", "password"},
+                              std::pair{"client_encoding", "client_encoding"}}) {
+        const auto &value = dbClient[key];
+        if (value.isNull() || (value.isString() && value.asString().empty())) {
+            continue;
+        }
+        // single quotes keep spaces and '=' in the value; backslash escapes a quote or backslash inside
+        std::string quoted = "'";
+        for (auto c: value.asString()) {
+            if (c == '\\' || c == '\'') {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+        quoted += '\'';
+        info += (info.empty() ? "" : " ") + std::string(option) + "=" + quoted;
+    }
+    return info;
+}
+
+void DbRouter::configurePool(const Json::Value &config, const Json::Value &primaryClient) {
+    if (!config.get("enabled", false).asBool()) {
+        pool_.reset();
+        return;
+    }
+    DbPool::Options options;
+    options.connectionInfo = config.get("connection_info", "").asString();
+    if (options.connectionInfo.empty()) {
+        options.connectionInfo = connectionInfo(primaryClient);
+    }
+    options.scaling.minSize = config.get("min_connections", 1).asUInt64();
+    options.scaling.maxSize = config.get("max_connections", 16).asUInt64();
+    options.scaling.growQueueDepth = config.get("grow_queue_depth", 2).asUInt64();
+    options.scaling.growWaitMs = config.get("grow_wait_ms", 5).asDouble();
+    options.scaling.maxQueryMs = config.get("max_query_ms", 250).asDouble();
+    options.scaling.shrinkUtilization = config.get("shrink_utilization", 0.5).asDouble();
+    options.scaling.shrinkAfter = config.get("shrink_after_intervals", 20).asUInt64();
+    options.acquireTimeout = std::chrono::milliseconds(config.get("acquire_timeout_ms", 2000).asInt64());
+    options.scaleInterval = config.get("scale_interval_ms", 500).asDouble() / 1000.0;
+    pool_ = std::make_unique<DbPool>(options);
+}
+
+void DbRouter::start() {
+    if (pool_) {
+        pool_->start();
+    }
+    for (auto &replica: replicas_) {
+        replica->client = app().getDbClient(replica->name);
+        if (!replica->client) {
+            LOG_ERROR << "Replica db client " << replica->name << " is not configured in db_clients";
+            continue;
+        }
+        auto *target = replica.get();
+        poll(*target);
+        app().getLoop()->runEvery(pollInterval_, [this, target]() { poll(*target); });
+    }
+}
+
+void DbRouter::poll(Replica &replica) {
+    // a replica that answers slower than the poll interval would otherwise pile up queries on its connections
+    if (replica.polling.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    replica.client->execSqlAsync(
+        sqlForReplayedLsn(),
+        [&replica](const Result &r) {
+            replica.polling.store(false, std::memory_order_release);
+            if (r.empty() || r[0][0].isNull()) {
+                return;
+            }
+            if (auto lsn = parse_pg_lsn(r[0][0].as<std::string>())) {
+                replica.replayedLsn.store(*lsn, std::memory_order_release);
+                replica.lastPollMs.store(steadyNowMs(), std::memory_order_release);
+            }
+        },
+        [&replica](const DrogonDbException &e) {
+            replica.polling.store(false, std::memory_order_release);
+            LOG_DEBUG << "Polling replica " << replica.name << " failed: " << e.base().what();
+        });
+}
+
+DbClientPtr DbRouter::writer() const {
+    return app().getDbClient(primaryName_);
+}
+
+bool DbRouter::usable(const Replica &replica, uint64_t minLsn, int64_t nowMs) const {
+    auto lastPoll = replica.lastPollMs.load(std::memory_order_acquire);
+    return replica.client && lastPoll != 0 && nowMs - lastPoll <= maxStalenessMs_ &&
+           replica.replayedLsn.load(std::memory_order_acquire) >= minLsn;
+}
+
+DbRouter::Replica *DbRouter::pickReplica(uint64_t minLsn, const Replica *exclude) {
+    if (replicas_.empty()) {
+        return nullptr;
+    }
+    auto nowMs = steadyNowMs();
+    auto start = nextReplica_.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 0; i < replicas_.size(); ++i) {
+        auto *replica = replicas_[(start + i) % replicas_.size()].get();
+        if (replica != exclude && usable(*replica, minLsn, nowMs)) {
+            return replica;
+        }
+    }
+    return nullptr;
+}
+
+DbClientPtr DbRouter::clientFor(Replica *replica, uint64_t minLsn) {
+    if (replica) {
+        replica->reads.fetch_add(1, std::memory_order_relaxed);
+        return replica->client;
+    }
+    countPrimaryRead(minLsn);
+    return writer();
+}
+
+void DbRouter::countPrimaryRead(uint64_t minLsn) {
+    if (minLsn != 0 && !replicas_.empty()) {
+        pinnedReads_.fetch_add(1, std::memory_order_relaxed);
+    }
+    primaryReads_.fetch_add(1, std::memory_order_relaxed);
+}
+
+DbClientPtr DbRouter::reader(uint64_t minLsn) {
+    return clientFor(pickReplica(minLsn, nullptr), minLsn);
+}
+
+void DbRouter::onPrimary(Query query, ResultCallback rcb, ExceptionCallback ecb) {
+    if (pool_) {
+        pool_->execute(std::move(query), std::move(rcb), std::move(ecb));
+        return;
+    }
+    query(writer(), std::move(rcb), std::move(ecb));
+}
+
+uint64_t DbRouter::requestToken(const HttpRequestPtr &req) const {
+    const auto &token = req->getHeader(tokenHeader_);
+    if (token.empty()) {
+        return 0;
+    }
+    return parse_pg_lsn(token).value_or(0);
+}
+
+DbClientPtr DbRouter::reader(const HttpRequestPtr &req) {
+    return reader(requestToken(req));
+}
+
+uint64_t DbRouter::freshLsn(const HttpRequestPtr &req) const {
+    return std::max(requestToken(req), lastWriteLsn_.load(std::memory_order_acquire));
+}
+
+DbClientPtr DbRouter::freshReader(const HttpRequestPtr &req) {
+    return reader(freshLsn(req));
+}
+
+void DbRouter::noteWrite(uint64_t lsn) {
+    auto current = lastWriteLsn_.load(std::memory_order_relaxed);
+    while (current < lsn && !lastWriteLsn_.compare_exchange_weak(current, lsn, std::memory_order_acq_rel)) {
+    }
+}
+
+void DbRouter::respondAfterWrite(const HttpResponsePtr &resp, const Callback &callback,
+                                 const std::function<void()> &onNoted) {
+    if (replicas_.empty()) {
+        callback(resp);
+        return;
+    }
+    // the write has committed by now, so the current position covers it
+    writer()->execSqlAsync(
+        sqlForCurrentLsn(),
+        [this, resp, callback, onNoted](const Result &r) {
+            if (!r.empty()) {
+                if (auto lsn = parse_pg_lsn(r[0][0].as<std::string>())) {
+                    noteWrite(*lsn);
+                    resp->addHeader(tokenHeader_, format_pg_lsn(*lsn));
+                }
+            }
+            if (onNoted) {
+                onNoted();
+            }
+            callback(resp);
+        },
+        [resp, callback](const DrogonDbException &e) {
+            // the write itself succeeded; the client just loses read-your-writes for this response
+            LOG_ERROR << "Reading the primary WAL position failed: " << e.base().what();
+            callback(resp);
+        });
+}
+
+Task<HttpResponsePtr> DbRouter::afterWriteCoro(HttpResponsePtr resp, uint64_t writtenLsn) {
+    if (replicas_.empty()) {
+        co_return resp;
+    }
+    if (writtenLsn != 0) {
+        resp->addHeader(tokenHeader_, format_pg_lsn(writtenLsn));
+        co_return resp;
+    }
+    try {
+        auto r = co_await writer()->execSqlCoro(sqlForCurrentLsn());
+        if (!r.empty()) {
+            if (auto lsn = parse_pg_lsn(r[0][0].as<std::string>())) {
+                noteWrite(*lsn);
+                resp->addHeader(tokenHeader_, format_pg_lsn(*lsn));
+            }
+        }
+    } catch (const DrogonDbException &e) {
+        LOG_ERROR << "Reading the primary WAL position failed: " << e.base().what();
+    }
+    co_return resp;
+}
+
+Task<uint64_t> DbRouter::writePositionCoro() {
+    try {
+        auto r = co_await writer()->execSqlCoro(sqlForCurrentLsn());
+        if (!r.empty()) {
+            if (auto lsn = parse_pg_lsn(r[0][0].as<std::string>())) {
+                if (!replicas_.empty()) {
+                    noteWrite(*lsn);
+                }
+                co_return *lsn;
+            }
+        }
+    } catch (const DrogonDbException &e) {
+        LOG_ERROR << "Reading the primary WAL position failed: " << e.base().what();
+    }
+    co_return 0;
+}
+
+Task<uint64_t> DbRouter::replayedPositionCoro(DbClientPtr client) {
+    try {
+        auto r = co_await client->execSqlCoro(sqlForReplayedLsn());
+        if (!r.empty() && !r[0][0].isNull()) {
+            if (auto lsn = parse_pg_lsn(r[0][0].as<std::string>())) {
+                co_return *lsn;
+            }
+        }
+    } catch (const DrogonDbException &e) {
+        LOG_ERROR << "Reading the replayed WAL position failed: " << e.base().what();
+    }
+    co_return 0;
+}
+
+void DbRouter::afterRemoteWrite(std::function<void()> then) {
+    if (replicas_.empty()) {
+        then();
+        return;
+    }
+    writer()->execSqlAsync(
+        sqlForCurrentLsn(),
+        [this, then](const Result &r) {
+            if (!r.empty()) {
+                if (auto lsn = parse_pg_lsn(r[0][0].as<std::string>())) {
+                    noteWrite(*lsn);
+                }
+            }
+            then();
+        },
+        [then](const DrogonDbException &e) {
+            LOG_ERROR << "Reading the primary WAL position failed: " << e.base().what();
+            then();
+        });
+}
+
+std::chrono::microseconds DbRouter::hedgeDelay() const {
+    auto observed = hedging_.latencies->percentile();
+    if (!observed) {
+        return hedging_.initialDelay;
+    }
+    return std::clamp(std::chrono::microseconds(*observed), hedging_.minDelay, hedging_.maxDelay);
+}
+
+void DbRouter::hedgedRead(uint64_t minLsn, Query query, ResultCallback rcb, ExceptionCallback ecb) {
+    auto *first = pickReplica(minLsn, nullptr);
+    if (!first) {
+        countPrimaryRead(minLsn);
+        onPrimary(std::move(query), std::move(rcb), std::move(ecb));
+        return;
+    }
+    if (!hedging_.enabled) {
+        query(clientFor(first, minLsn), std::move(rcb), std::move(ecb));
+        return;
+    }
+    hedging_.reads.fetch_add(1, std::memory_order_relaxed);
+
+    struct Attempts {
+        std::atomic<bool> answered{false};
+        std::atomic<int> running{1};
+        ResultCallback rcb;
+        ExceptionCallback ecb;
+    };
+    auto attempts = std::make_shared<Attempts>();
+    attempts->rcb = std::move(rcb);
+    attempts->ecb = std::move(ecb);
+
+    auto run = [this, query, attempts](Replica *replica, bool hedge) {
+        auto started = std::chrono::steady_clock::now();
+        query(
+            clientFor(replica, 0),
+            [this, attempts, started, hedge](const Result &r) {
+                hedging_.latencies->record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started)
+                        .count()));
+                attempts->running.fetch_sub(1, std::memory_order_acq_rel);
+                if (attempts->answered.exchange(true)) {
+                    return;
+                }
+                if (hedge) {
+                    hedging_.hedgeWins.fetch_add(1, std::memory_order_relaxed);
+                }
+                attempts->rcb(r);
+            },
+            [attempts](const DrogonDbException &e) {
+                if (attempts->running.fetch_sub(1, std::memory_order_acq_rel) > 1) {
+                    return; // the other attempt may still succeed
+                }
+                if (!attempts->answered.exchange(true)) {
+                    attempts->ecb(e);
+                }
+            });
+    };
+
+    run(first, false);
+
+    auto *loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    if (!loop) {
+        loop = app().getLoop();
+    }
+    loop->runAfter(std::chrono::duration<double>(hedgeDelay()), [this, attempts, run, first, minLsn]() {
+        if (attempts->answered.load(std::memory_order_acquire)) {
+            return;
+        }
+        auto *second = pickReplica(minLsn, first);
+        if (!second) {
+            return;
+        }
+        attempts->running.fetch_add(1, std::memory_order_acq_rel);
+        hedging_.hedged.fetch_add(1, std::memory_order_relaxed);
+        run(second, true);
+    });
+}
+
+Json::Value DbRouter::poolStats() const {
+    return pool_ ? pool_->stats() : Json::Value();
+}
+
+Json::Value DbRouter::stats() const {
+    Json::Value stats;
+    auto nowMs = steadyNowMs();
+    stats["primary"] = primaryName_;
+    stats["primary_reads"] = static_cast<Json::UInt64>(primaryReads_.load(std::memory_order_relaxed));
+    stats["pinned_reads"] = static_cast<Json::UInt64>(pinnedReads_.load(std::memory_order_relaxed));
+    stats["last_write_lsn"] = format_pg_lsn(lastWriteLsn_.load(std::memory_order_relaxed));
+    auto &hedging = stats["hedging"];
+    auto hedgedReads = hedging_.reads.load(std::memory_order_relaxed);
+    auto hedged = hedging_.hedged.load(std::memory_order_relaxed);
+    hedging["enabled"] = hedging_.enabled;
+    hedging["reads"] = static_cast<Json::UInt64>(hedgedReads);
+    hedging["hedged"] = static_cast<Json::UInt64>(hedged);
+    hedging["hedge_wins"] = static_cast<Json::UInt64>(hedging_.hedgeWins.load(std::memory_order_relaxed));
+    hedging["hedge_rate"] = hedgedReads == 0 ? 0.0 : static_cast<double>(hedged) / static_cast<double>(hedgedReads);
+    hedging["delay_ms"] = static_cast<double>(hedgeDelay().count()) / 1000.0;
+    stats["replicas"] = Json::Value(Json::arrayValue);
+    for (const auto &replica: replicas_) {
+        Json::Value entry;
+        entry["name"] = replica->name;
+        entry["replayed_lsn"] = format_pg_lsn(replica->replayedLsn.load(std::memory_order_relaxed));
+        entry["healthy"] = usable(*replica, 0, nowMs);
+        entry["reads"] = static_cast<Json::UInt64>(replica->reads.load(std::memory_order_relaxed));
+        stats["replicas"].append(entry);
+    }
+    return stats;
+}
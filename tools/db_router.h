@@ -0,0 +1,152 @@
+#pragma once
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <drogon/orm/DbClient.h>
+#include <drogon/utils/coroutine.h>
+#include <json/json.h>
+#include "db_pool.h"
+#include "latency_window.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Routes queries between the primary db client and its streaming replicas (custom_config.db_routing).
+// Writes go to the primary, which stamps the response with its WAL position; a client that sends that
+// token back on a read is only served by a replica that has replayed at least that far, and by the
+// primary otherwise. Replica positions are polled in the background, so routing a read costs no query.
+class DbRouter {
+public:
+    using Callback = std::function<void(const drogon::HttpResponsePtr &)>;
+
+    static DbRouter &instance();
+
+    // Reads custom_config.db_routing; call before app().run()
+    void configure(const Json::Value &config);
+
+    // Reads custom_config.db_pool; when enabled, queries sent through onPrimary() use an adaptive pool. Without a
+    // connection_info its connections are opened with primaryClient, the primary's entry of db_clients
+    void configurePool(const Json::Value &config, const Json::Value &primaryClient);
+
+    // libpq connection string of a db_clients entry
+    static std::string connectionInfo(const Json::Value &dbClient);
+
+    // Starts polling the replicas and opens the pool; call once the db clients exist (beginning advice)
+    void start();
+
+    drogon::orm::DbClientPtr writer() const;
+
+    // Client for a read that must observe every write up to minLsn (0: any replica will do)
+    drogon::orm::DbClientPtr reader(uint64_t minLsn = 0);
+
+    // Honours the request's read-your-writes token
+    drogon::orm::DbClientPtr reader(const drogon::HttpRequestPtr &req);
+
+    // The replica must also have replayed every write made through this process: for results that are cached
+    // here (a lagging replica could put back a row a write just evicted) and for reads like login that
+    // clients expect to see a write they did not get a token for
+    drogon::orm::DbClientPtr freshReader(const drogon::HttpRequestPtr &req);
+
+    // Position freshReader(req) requires a replica to have replayed
+    uint64_t freshLsn(const drogon::HttpRequestPtr &req) const;
+
+    // Token carried by the request, 0 when there is none or it is malformed
+    uint64_t requestToken(const drogon::HttpRequestPtr &req) const;
+
+    // Answer a successful write: fetch the primary's WAL position, remember it and put it on resp
+    // as the read-your-writes token. Without replicas the response goes out untouched.
+    // onNoted runs once freshReader() can no longer pick a replica that misses the write; caches that
+    // were invalidated when the write returned are invalidated again there, since a read on a lagging
+    // replica may have refilled them in between.
+    void respondAfterWrite(const drogon::HttpResponsePtr &resp, const Callback &callback,
+                           const std::function<void()> &onNoted = nullptr);
+
+    // writtenLsn: the position writePositionCoro() returned for this write, so it is not fetched twice
+    drogon::Task<drogon::HttpResponsePtr> afterWriteCoro(drogon::HttpResponsePtr resp, uint64_t writtenLsn = 0);
+
+    // The primary's WAL position once a write has committed, remembered like respondAfterWrite() does; fetched
+    // with or without replicas, for versioning the write. 0 when it could not be read.
+    drogon::Task<uint64_t> writePositionCoro();
+
+    // The position client's server has replayed (the primary: written). A read sent to client after this returns
+    // sees every write up to it. 0 when it could not be read.
+    static drogon::Task<uint64_t> replayedPositionCoro(drogon::orm::DbClientPtr client);
+
+    // Another instance has written: fetch the primary's WAL position, which covers that write, and remember it
+    // like one of ours before running then, so reads through freshReader() that start afterwards cannot land on
+    // a replica that misses it. Without replicas then runs right away.
+    void afterRemoteWrite(std::function<void()> then);
+
+    bool hasReplicas() const {
+        return !replicas_.empty();
+    }
+
+    const std::string &tokenHeader() const {
+        return tokenHeader_;
+    }
+
+    using Query = DbPool::Query;
+
+    // Run query on the primary: on a connection of the adaptive pool when one is configured, otherwise
+    // on writer()
+    void onPrimary(Query query, drogon::orm::ResultCallback rcb, drogon::orm::ExceptionCallback ecb);
+
+    // Run an idempotent read on reader(minLsn). With hedging enabled, if it has not answered within the
+    // hedge delay (a percentile of recent read latencies) the same query also goes to a second eligible
+    // replica and whichever answers first wins. drogon cannot cancel a query in flight, so the slower
+    // answer is dropped when it arrives. An error only surfaces once no attempt is left running.
+    void hedgedRead(uint64_t minLsn, Query query, drogon::orm::ResultCallback rcb,
+                    drogon::orm::ExceptionCallback ecb);
+
+    Json::Value stats() const;
+
+    // Size, use, wait/query time histograms and timeouts of the adaptive pool; null without one
+    Json::Value poolStats() const;
+
+private:
+    DbRouter() = default;
+
+    struct Replica {
+        std::string name;
+        drogon::orm::DbClientPtr client;
+        std::atomic<uint64_t> replayedLsn{0};
+        std::atomic<int64_t> lastPollMs{0}; // steady clock; 0 until the first successful poll
+        std::atomic<uint64_t> reads{0};
+        std::atomic<bool> polling{false}; // a poll is in flight; a tick that finds one skips its own
+    };
+
+    Replica *pickReplica(uint64_t minLsn, const Replica *exclude);
+    drogon::orm::DbClientPtr clientFor(Replica *replica, uint64_t minLsn);
+    void countPrimaryRead(uint64_t minLsn);
+    std::chrono::microseconds hedgeDelay() const;
+    void poll(Replica &replica);
+    void noteWrite(uint64_t lsn);
+    bool usable(const Replica &replica, uint64_t minLsn, int64_t nowMs) const;
+
+    std::string primaryName_ = "default";
+    std::vector<std::unique_ptr<Replica>> replicas_;
+    std::string tokenHeader_ = "X-Read-After";
+    double pollInterval_ = 0.1;
+    int64_t maxStalenessMs_ = 1000;
+    std::atomic<uint64_t> lastWriteLsn_{0};
+    std::atomic<uint64_t> nextReplica_{0};
+    std::atomic<uint64_t> primaryReads_{0};
+    std::atomic<uint64_t> pinnedReads_{0};
+
+    struct Hedging {
+        bool enabled = false;
+        std::chrono::microseconds minDelay{2000};
+        std::chrono::microseconds maxDelay{100000};
+        std::chrono::microseconds initialDelay{10000}; // until the window has enough samples
+        std::unique_ptr<LatencyWindow> latencies = std::make_unique<LatencyWindow>(1024, 95.0);
+        std::atomic<uint64_t> reads{0};
+        std::atomic<uint64_t> hedged{0};
+        std::atomic<uint64_t> hedgeWins{0};
+    };
+    Hedging hedging_;
+
+    std::unique_ptr<DbPool> pool_;
+};
@@ -0,0 +1,175 @@
+#include "invalidation_bus.h"
+#include <memory>
+
+namespace {
+    std::string encodeOne(const InvalidationBus::Message &message) {
+        Json::Value value;
+        value["entity"] = message.entity;
+        value["key"] = message.key;
+        value["version"] = static_cast<Json::Int64>(message.version);
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        return Json::writeString(builder, value);
+    }
+
+    bool decodeOne(const Json::Value &value, InvalidationBus::Message &message) {
+        if (!value.isObject() || !value["entity"].isString() || !value["key"].isString() ||
+            !value["version"].isInt64()) {
+            return false;
+        }
+        message.entity = value["entity"].asString();
+        message.key = value["key"].asString();
+        message.version = value["version"].asInt64();
+        return !message.entity.empty() && message.version >= 0;
+    }
+
+    std::string floorKey(const std::string &entity, const std::string &key) {
+        return entity + ':' + key;
+    }
+}
+
+InvalidationBus::InvalidationBus(size_t capacity, std::chrono::milliseconds memory) : floors_(capacity, memory) {
+}
+
+InvalidationBus &InvalidationBus::instance() {
+    // longer than any cache TTL in config.json, so a floor outlives the entries it protects
+    static InvalidationBus bus(100000, std::chrono::minutes(10));
+    return bus;
+}
+
+std::string InvalidationBus::encode(const std::vector<Message> &messages) {
+    std::string payload = "[";
+    for (const auto &message: messages) {
+        if (payload.size() > 1) {
+            payload += ',';
+        }
+        payload += encodeOne(message);
+    }
+    payload += ']';
+    return payload;
+}
+
+std::vector<InvalidationBus::Message> InvalidationBus::decode(const std::string &payload) {
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errors;
+    if (!reader->parse(payload.data(), payload.data() + payload.size(), &root, &errors)) {
+        return {};
+    }
+    std::vector<Message> messages;
+    Message message;
+    if (root.isObject()) {
+        if (decodeOne(root, message)) {
+            messages.push_back(std::move(message));
+        }
+        return messages;
+    }
+    if (!root.isArray()) {
+        return {};
+    }
+    for (const auto &value: root) {
+        if (decodeOne(value, message)) {
+            messages.push_back(std::move(message));
+        }
+    }
+    return messages;
+}
+
+void InvalidationBus::on(const std::string &entity, Evict evict) {
+    handlers_[entity] = std::move(evict);
+}
+
+void InvalidationBus::setForwarding(bool forwarding) {
+    forwarding_.store(forwarding, std::memory_order_release);
+}
+
+void InvalidationBus::publish(const std::string &entity, const std::string &key, int64_t version) {
+    published_.fetch_add(1, std::memory_order_relaxed);
+    Message message{entity, key, version};
+    advance(message);
+    if (!forwarding_.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(outboxMutex_);
+    outbox_.push_back(std::move(message));
+}
+
+std::vector<std::string> InvalidationBus::drain(size_t maxPayload) {
+    std::vector<Message> messages;
+    {
+        std::lock_guard<std::mutex> lock(outboxMutex_);
+        messages.swap(outbox_);
+    }
+    std::vector<std::string> payloads;
+    std::string payload;
+    for (const auto &message: messages) {
+        auto encoded = encodeOne(message);
+        // the brackets and the separating comma
+        if (!payload.empty() && payload.size() + encoded.size() + 2 > maxPayload) {
+            payloads.push_back(payload + ']');
+            payload.clear();
+        }
+        payload += payload.empty() ? "[" : ",";
+        payload += encoded;
+    }
+    if (!payload.empty()) {
+        payloads.push_back(payload + ']');
+    }
+    return payloads;
+}
+
+size_t InvalidationBus::receive(const std::string &payload) {
+    size_t applied = 0;
+    for (const auto &message: decode(payload)) {
+        received_.fetch_add(1, std::memory_order_relaxed);
+        auto handler = handlers_.find(message.entity);
+        if (handler == handlers_.end()) {
+            continue;
+        }
+        if (!advance(message)) {
+            stale_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        handler->second(message.key);
+        ++applied;
+    }
+    applied_.fetch_add(applied, std::memory_order_relaxed);
+    return applied;
+}
+
+bool InvalidationBus::admit(const std::string &entity, const std::string &key, int64_t version) {
+    std::lock_guard<std::mutex> lock(floorsMutex_);
+    auto floor = floors_.get(floorKey(entity, key));
+    if (floor && version < *floor) {
+        refused_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool InvalidationBus::advance(const Message &message) {
+    if (message.version == kUnversioned) {
+        return true;
+    }
+    auto key = floorKey(message.entity, message.key);
+    std::lock_guard<std::mutex> lock(floorsMutex_);
+    auto floor = floors_.get(key);
+    if (floor && message.version <= *floor) {
+        return false;
+    }
+    floors_.put(key, message.version);
+    return true;
+}
+
+Json::Value InvalidationBus::stats() const {
+    Json::Value stats;
+    stats["forwarding"] = forwarding_.load(std::memory_order_relaxed);
+    stats["published"] = static_cast<Json::UInt64>(published_.load(std::memory_order_relaxed));
+    stats["received"] = static_cast<Json::UInt64>(received_.load(std::memory_order_relaxed));
+    stats["applied"] = static_cast<Json::UInt64>(applied_.load(std::memory_order_relaxed));
+    stats["stale"] = static_cast<Json::UInt64>(stale_.load(std::memory_order_relaxed));
+    stats["refused_fills"] = static_cast<Json::UInt64>(refused_.load(std::memory_order_relaxed));
+    stats["tracked_keys"] = static_cast<Json::UInt64>(floors_.size());
+    return stats;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <json/json.h>
+#include "lru_cache.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Cache invalidation shared by every instance behind the load balancer. A writer publishes {entity, key, version}
+// after its write; the messages are carried to the other instances (tools/invalidation_channel.h) and each one
+// evicts the key from its local caches. Per key the bus remembers the highest version it has seen, so a message
+// that arrives late or twice is dropped, and admit() keeps a cache fill older than that version out of the cache.
+class InvalidationBus {
+public:
+    struct Message {
+        std::string entity;
+        std::string key;
+        int64_t version = 0;
+    };
+
+    using Evict = std::function<void(const std::string &key)>;
+
+    // Version of a write whose order is unknown (e.g. a failed round trip that may have committed):
+    // it always evicts and never raises the floor
+    static constexpr int64_t kUnversioned = 0;
+    // Version of a delete of a key that is never reused; nothing may be cached for it afterwards
+    static constexpr int64_t kDeleted = std::numeric_limits<int64_t>::max();
+
+    // capacity keys remember their floor for memory; both should cover the lifetime of a cache entry
+    InvalidationBus(size_t capacity, std::chrono::milliseconds memory);
+
+    static InvalidationBus &instance();
+
+    // JSON array of messages; decode() also accepts a single object and skips malformed entries
+    static std::string encode(const std::vector<Message> &messages);
+    static std::vector<Message> decode(const std::string &payload);
+
+    // Evict handler of entity on this instance; register before the first message arrives
+    void on(const std::string &entity, Evict evict);
+
+    // Queue published messages for drain(); off until a channel carries them
+    void setForwarding(bool forwarding);
+
+    // Called after the write; the writer evicts its own caches, so this only raises the local floor
+    // and queues the message for the other instances
+    void publish(const std::string &entity, const std::string &key, int64_t version);
+
+    // Queued messages as payloads of at most maxPayload bytes (Postgres caps a NOTIFY at 8000)
+    std::vector<std::string> drain(size_t maxPayload = 7900);
+
+    // Apply a payload from another instance, returns the number of messages that evicted something
+    size_t receive(const std::string &payload);
+
+    // May a row of entity/key at version be cached? False once a newer version was published or received
+    bool admit(const std::string &entity, const std::string &key, int64_t version);
+
+    Json::Value stats() const;
+
+private:
+    // Raise the floor of message's key; false when the message is stale
+    bool advance(const Message &message);
+
+    ShardedLruCache<std::string, int64_t> floors_;
+    std::mutex floorsMutex_; // floors_ check-and-set
+    std::unordered_map<std::string, Evict> handlers_;
+    std::mutex outboxMutex_;
+    std::vector<Message> outbox_;
+    std::atomic<bool> forwarding_{false};
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> received_{0};
+    std::atomic<uint64_t> applied_{0};
+    std::atomic<uint64_t> stale_{0};
+    std::atomic<uint64_t> refused_{0};
+};
@@ -0,0 +1,41 @@
+#include "invalidation_channel.h"
+#include <drogon/drogon.h>
+#include <drogon/orm/DbListener.h>
+#include "db_router.h"
+#include <memory>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+void InvalidationChannel::start(const Json::Value &config, InvalidationBus &bus) {
+    if (!config.get("enabled", false).asBool()) {
+        return;
+    }
+    auto channel = config.get("channel", "cache_invalidation").asString();
+    auto connectionInfo = config.get("connection_info", "").asString();
+    if (connectionInfo.empty()) {
+        LOG_ERROR << "custom_config.invalidation.connection_info is required to listen on " << channel;
+        return;
+    }
+    auto flushInterval = config.get("flush_interval_ms", 5).asDouble() / 1000.0;
+
+    // our own messages come back as well; the bus drops them as not newer than what was published.
+    // Evicting only once fresh reads require the writes' WAL position keeps a lagging replica from refilling
+    static std::shared_ptr<DbListener> listener = DbListener::newPgListener(connectionInfo);
+    listener->listen(channel, [&bus](const std::string &, const std::string &payload) {
+        DbRouter::instance().afterRemoteWrite([&bus, payload]() { bus.receive(payload); });
+    });
+
+    bus.setForwarding(true);
+    app().getLoop()->runEvery(flushInterval, [&bus, channel]() {
+        for (auto &payload: bus.drain()) {
+            DbRouter::instance().writer()->execSqlAsync(
+                "select pg_notify($1, $2)", [](const Result &) {},
+                [channel](const DrogonDbException &e) {
+                    LOG_ERROR << "Publishing invalidations on " << channel << " failed: " << e.base().what();
+                },
+                channel, payload);
+        }
+    });
+    LOG_INFO << "Cache invalidations are exchanged on channel " << channel;
+}
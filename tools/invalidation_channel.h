@@ -0,0 +1,12 @@
+#pragma once
+#include <json/json.h>
+#include "invalidation_bus.h"
+
+// Carries InvalidationBus messages between the instances over Postgres LISTEN/NOTIFY (custom_config.invalidation).
+// Published messages are batched into one NOTIFY every flush_interval_ms; NOTIFY is fire-and-forget, so a message
+// lost with a dropped connection is only made up for by the cache TTLs.
+class InvalidationChannel {
+public:
+    // Listen on a dedicated connection and start forwarding the bus; call once the db clients exist
+    static void start(const Json::Value &config, InvalidationBus &bus);
+};
@@ -0,0 +1,310 @@
+#include "inverted_index.h"
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+namespace {
+    bool isWordByte(unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+    }
+
+    void insertSorted(std::vector<uint32_t> &ids, uint32_t id) {
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it == ids.end() || *it != id) {
+            ids.insert(it, id);
+        }
+    }
+
+    bool eraseSorted(std::vector<uint32_t> &ids, uint32_t id) {
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it == ids.end() || *it != id) {
+            return false;
+        }
+        ids.erase(it);
+        return true;
+    }
+
+    // better first: higher score, then newer id
+    bool ranksBefore(const InvertedIndex::Hit &a, const InvertedIndex::Hit &b) {
+        return a.score != b.score ? a.score > b.score : a.id > b.id;
+    }
+}
+
+std::vector<std::string> InvertedIndex::tokenize(const std::string &text) {
+    std::vector<std::string> tokens;
+    std::string token;
+    auto flush = [&]() {
+        if (token.size() > 1) {
+            tokens.push_back(token);
+        }
+        token.clear();
+    };
+    for (unsigned char c: text) {
+        if (!isWordByte(c)) {
+            flush();
+            continue;
+        }
+        token += (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : static_cast<char>(c);
+    }
+    flush();
+    return tokens;
+}
+
+std::vector<std::string> InvertedIndex::termsOf(const std::string &title, const std::string &description) {
+    auto terms = tokenize(title);
+    auto more = tokenize(description);
+    terms.insert(terms.end(), more.begin(), more.end());
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    return terms;
+}
+
+void InvertedIndex::upsert(uint32_t id, const std::string &title, const std::string &description) {
+    auto terms = termsOf(title, description);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    index(id, terms);
+}
+
+bool InvertedIndex::insertIfAbsent(uint32_t id, const std::string &title, const std::string &description) {
+    auto terms = termsOf(title, description);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (documents_.count(id) || tombstones_.count(id)) {
+        return false;
+    }
+    index(id, terms);
+    return true;
+}
+
+void InvertedIndex::beginLoad() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    loading_ = true;
+}
+
+void InvertedIndex::endLoad() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    loading_ = false;
+    tombstones_.clear();
+}
+
+void InvertedIndex::index(uint32_t id, const std::vector<std::string> &terms) {
+    std::vector<uint32_t> termIds;
+    termIds.reserve(terms.size());
+    for (const auto &term: terms) {
+        termIds.push_back(intern(term));
+    }
+    std::sort(termIds.begin(), termIds.end());
+    auto &current = documents_[id];
+    // only the terms that changed touch a posting list
+    std::vector<uint32_t> gone, added;
+    std::set_difference(current.begin(), current.end(), termIds.begin(), termIds.end(), std::back_inserter(gone));
+    std::set_difference(termIds.begin(), termIds.end(), current.begin(), current.end(), std::back_inserter(added));
+    for (auto term: gone) {
+        removeFrom(term, id);
+    }
+    for (auto term: added) {
+        addTo(term, id);
+    }
+    termIds.shrink_to_fit();
+    current = std::move(termIds);
+}
+
+uint32_t InvertedIndex::intern(const std::string &term) {
+    auto [it, inserted] = termIds_.try_emplace(term, 0);
+    if (inserted) {
+        if (freeTermIds_.empty()) {
+            it->second = static_cast<uint32_t>(terms_.size());
+            terms_.emplace_back();
+        } else {
+            it->second = freeTermIds_.back();
+            freeTermIds_.pop_back();
+        }
+        terms_[it->second].text = &it->first;
+    }
+    return it->second;
+}
+
+void InvertedIndex::remove(uint32_t id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (loading_) {
+        tombstones_.insert(id);
+    }
+    auto it = documents_.find(id);
+    if (it == documents_.end()) {
+        return;
+    }
+    for (auto term: it->second) {
+        removeFrom(term, id);
+    }
+    documents_.erase(it);
+}
+
+void InvertedIndex::addTo(uint32_t term, uint32_t id) {
+    auto &entry = terms_[term];
+    ++entry.documents;
+    // a product that left and came back is still in base
+    if (!eraseSorted(entry.removed, id)) {
+        insertSorted(entry.added, id);
+    }
+    compact(entry);
+}
+
+void InvertedIndex::removeFrom(uint32_t term, uint32_t id) {
+    auto &entry = terms_[term];
+    if (--entry.documents == 0) {
+        // no product has the term any more: drop its text and lists and hand the id to the next new term
+        termIds_.erase(*entry.text);
+        entry = Term();
+        freeTermIds_.push_back(term);
+        return;
+    }
+    if (!eraseSorted(entry.added, id)) {
+        insertSorted(entry.removed, id);
+    }
+    compact(entry);
+}
+
+void InvertedIndex::compact(Term &entry) {
+    auto pending = entry.added.size() + entry.removed.size();
+    if (pending <= std::max<size_t>(64, entry.base.size() / 8)) {
+        return;
+    }
+    std::vector<uint32_t> ids;
+    postings(entry, 0, std::numeric_limits<uint32_t>::max(), ids);
+    entry.base = PostingList(ids);
+    entry.added.clear();
+    entry.removed.clear();
+}
+
+void InvertedIndex::postings(const Term &entry, uint32_t lo, uint32_t hi, std::vector<uint32_t> &out) {
+    std::vector<uint32_t> base;
+    entry.base.decodeRange(lo, hi, base);
+    if (!entry.removed.empty()) {
+        std::vector<uint32_t> kept;
+        kept.reserve(base.size());
+        std::set_difference(base.begin(), base.end(), entry.removed.begin(), entry.removed.end(),
+                            std::back_inserter(kept));
+        base.swap(kept);
+    }
+    out.resize(base.size() + entry.added.size());
+    out.resize(union_sorted(base.data(), base.size(), entry.added.data(), entry.added.size(), out.data()));
+}
+
+std::vector<InvertedIndex::Hit> InvertedIndex::search(const std::string &query, Match match, size_t limit,
+                                                      std::optional<Hit> after) const {
+    auto words = tokenize(query);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    if (words.empty() || limit == 0) {
+        return {};
+    }
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<const Term *> entries;
+    for (const auto &word: words) {
+        auto it = termIds_.find(word);
+        if (it != termIds_.end()) {
+            entries.push_back(&terms_[it->second]);
+        } else if (match == Match::All) {
+            return {};
+        }
+    }
+    if (entries.empty()) {
+        return {};
+    }
+
+    constexpr uint32_t kMaxId = std::numeric_limits<uint32_t>::max();
+    std::vector<Hit> hits;
+    if (match == Match::All) {
+        // rarest term first, so every later list only has to be decoded where the survivors are
+        std::sort(entries.begin(), entries.end(),
+                  [](const Term *a, const Term *b) { return a->documents < b->documents; });
+        std::vector<uint32_t> ids, next, both;
+        postings(*entries[0], 0, kMaxId, ids);
+        for (size_t t = 1; t < entries.size() && !ids.empty(); ++t) {
+            next.clear();
+            postings(*entries[t], ids.front(), ids.back(), next);
+            both.resize(std::min(ids.size(), next.size()));
+            both.resize(intersect_sorted(ids.data(), ids.size(), next.data(), next.size(), both.data()));
+            ids.swap(both);
+        }
+        hits.reserve(ids.size());
+        for (auto id: ids) {
+            hits.push_back({id, 1.0f});
+        }
+    } else {
+        std::vector<std::vector<uint32_t>> lists(entries.size());
+        std::vector<uint32_t> ids, merged;
+        for (size_t t = 0; t < entries.size(); ++t) {
+            postings(*entries[t], 0, kMaxId, lists[t]);
+            merged.resize(ids.size() + lists[t].size());
+            merged.resize(union_sorted(ids.data(), ids.size(), lists[t].data(), lists[t].size(), merged.data()));
+            ids.swap(merged);
+        }
+        // one merge walk per term counts how many terms each id has
+        std::vector<uint8_t> matched(ids.size(), 0);
+        for (const auto &list: lists) {
+            size_t i = 0;
+            for (auto id: list) {
+                while (ids[i] < id) {
+                    ++i;
+                }
+                ++matched[i];
+            }
+        }
+        hits.reserve(ids.size());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            hits.push_back({ids[i], static_cast<float>(matched[i]) / static_cast<float>(words.size())});
+        }
+    }
+    lock.unlock();
+
+    if (after) {
+        hits.erase(std::remove_if(hits.begin(), hits.end(),
+                                  [&after](const Hit &hit) { return !ranksBefore(*after, hit); }),
+                   hits.end());
+    }
+    if (hits.size() > limit) {
+        std::partial_sort(hits.begin(), hits.begin() + static_cast<std::ptrdiff_t>(limit), hits.end(), ranksBefore);
+        hits.resize(limit);
+    } else {
+        std::sort(hits.begin(), hits.end(), ranksBefore);
+    }
+    return hits;
+}
+
+size_t InvertedIndex::documents() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return documents_.size();
+}
+
+size_t InvertedIndex::terms() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return termIds_.size();
+}
+
+size_t InvertedIndex::postingBytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t total = 0;
+    for (const auto &entry: terms_) {
+        total += entry.base.bytes() + (entry.added.size() + entry.removed.size()) * sizeof(uint32_t);
+    }
+    return total;
+}
+
+size_t InvertedIndex::documentBytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t total = 0;
+    for (const auto &[id, termIds]: documents_) {
+        total += sizeof(id) + termIds.capacity() * sizeof(uint32_t);
+    }
+    return total;
+}
+
+size_t InvertedIndex::termBytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t total = terms_.size() * sizeof(Term);
+    for (const auto &[text, id]: termIds_) {
+        total += text.size() + sizeof(id);
+    }
+    return total;
+}
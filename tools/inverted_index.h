@@ -0,0 +1,82 @@
+#pragma once
+#include "posting_list.h"
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// In-memory full-text index of product titles and descriptions. Each term's ids live in a compressed
+// PostingList; writes land in small sorted add/remove lists next to it and are folded into a new
+// PostingList once they grow past an eighth of it, so an update never re-encodes a long list.
+// Searches take a shared lock and run concurrently; writes take an exclusive one.
+class InvertedIndex {
+public:
+    enum class Match {
+        All, // every query term (intersection)
+        Any  // at least one (union), more matching terms rank higher
+    };
+
+    struct Hit {
+        uint32_t id = 0;
+        float score = 0; // share of the query terms the product contains
+    };
+
+    // Lowercased runs of letters and digits (bytes >= 0x80 count as letters, so UTF-8 words stay whole);
+    // single characters are dropped. Duplicates are kept.
+    static std::vector<std::string> tokenize(const std::string &text);
+
+    // Index (or re-index) a product
+    void upsert(uint32_t id, const std::string &title, const std::string &description);
+
+    // Index a product unless it is already indexed or was removed since beginLoad(), for a bulk load racing
+    // with live updates
+    bool insertIfAbsent(uint32_t id, const std::string &title, const std::string &description);
+
+    // Between the two, remove() leaves a tombstone so that a row the load read before its delete stays out
+    void beginLoad();
+    void endLoad();
+
+    void remove(uint32_t id);
+
+    // Best hits first (score, then newest id); `after` continues from the last hit of the previous page
+    std::vector<Hit> search(const std::string &query, Match match, size_t limit,
+                            std::optional<Hit> after = std::nullopt) const;
+
+    size_t documents() const;
+    size_t terms() const;
+    // Encoded posting lists plus the pending add/remove lists
+    size_t postingBytes() const;
+    // The term ids kept per product to re-index it, and the text of each distinct term
+    size_t documentBytes() const;
+    size_t termBytes() const;
+
+private:
+    struct Term {
+        const std::string *text = nullptr; // key in termIds_
+        uint32_t documents = 0;            // products that contain the term; its id is reused at 0
+        PostingList base;
+        std::vector<uint32_t> added;   // sorted, not in base
+        std::vector<uint32_t> removed; // sorted, in base
+    };
+
+    static std::vector<std::string> termsOf(const std::string &title, const std::string &description);
+    void index(uint32_t id, const std::vector<std::string> &terms); // with mutex_ held exclusively
+    uint32_t intern(const std::string &term);
+    void addTo(uint32_t term, uint32_t id);
+    void removeFrom(uint32_t term, uint32_t id);
+    void compact(Term &entry);
+    // base + added - removed, restricted to the blocks overlapping [lo, hi]
+    static void postings(const Term &entry, uint32_t lo, uint32_t hi, std::vector<uint32_t> &out);
+
+    mutable std::shared_mutex mutex_;
+    // Each distinct term is stored once; products refer to it by id
+    std::unordered_map<std::string, uint32_t> termIds_;
+    std::vector<Term> terms_; // by term id
+    std::vector<uint32_t> freeTermIds_;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> documents_; // sorted term ids per product
+    bool loading_ = false;
+    std::unordered_set<uint32_t> tombstones_; // removed while loading
+};
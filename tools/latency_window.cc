@@ -0,0 +1,42 @@
+#include "latency_window.h"
+#include <algorithm>
+#include <cmath>
+
+LatencyWindow::LatencyWindow(size_t capacity, double percentile, size_t refreshEvery)
+    : capacity_(std::max<size_t>(1, capacity)),
+      percentile_(std::clamp(percentile, 0.0, 100.0)),
+      refreshEvery_(std::max<size_t>(1, refreshEvery)) {
+    samples_.reserve(capacity_);
+}
+
+void LatencyWindow::record(uint64_t micros) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (samples_.size() < capacity_) {
+        samples_.push_back(micros);
+    } else {
+        samples_[next_] = micros;
+        next_ = (next_ + 1) % capacity_;
+    }
+    count_.fetch_add(1, std::memory_order_relaxed);
+    if (++sinceRefresh_ >= refreshEvery_) {
+        sinceRefresh_ = 0;
+        refresh();
+    }
+}
+
+// called with mutex_ held
+void LatencyWindow::refresh() {
+    std::vector<uint64_t> sorted(samples_);
+    auto rank = static_cast<size_t>(std::ceil(percentile_ / 100.0 * static_cast<double>(sorted.size())));
+    auto index = rank == 0 ? 0 : rank - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(index), sorted.end());
+    current_.store(sorted[index], std::memory_order_relaxed);
+    ready_.store(true, std::memory_order_release);
+}
+
+std::optional<uint64_t> LatencyWindow::percentile() const {
+    if (!ready_.load(std::memory_order_acquire)) {
+        return std::nullopt;
+    }
+    return current_.load(std::memory_order_relaxed);
+}
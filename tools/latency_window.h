@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// Sliding window over the last `capacity` latency samples that keeps one percentile of them up to date.
+// The percentile is recomputed every `refreshEvery` samples rather than on each read, so asking for it
+// on every query is a single atomic load.
+class LatencyWindow {
+public:
+    LatencyWindow(size_t capacity, double percentile, size_t refreshEvery = 64);
+
+    void record(uint64_t micros);
+
+    // std::nullopt until the window has seen refreshEvery samples
+    std::optional<uint64_t> percentile() const;
+
+    uint64_t count() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    void refresh();
+
+    const size_t capacity_;
+    const double percentile_;
+    const size_t refreshEvery_;
+    std::mutex mutex_;
+    std::vector<uint64_t> samples_; // ring buffer, next_ is the oldest once full
+    size_t next_ = 0;
+    size_t sinceRefresh_ = 0;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> current_{0};
+    std::atomic<bool> ready_{false};
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Size-bounded LRU cache with a per-entry TTL, split into independently locked shards
+// so that IO threads looking up different keys rarely contend on the same mutex.
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class ShardedLruCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ShardedLruCache(size_t capacity, std::chrono::milliseconds ttl, size_t shardCount = 16)
+        : ttl_(ttl), capacityPerShard_(std::max<size_t>(1, (capacity + shardCount - 1) / shardCount)) {
+        shards_.reserve(shardCount);
+        for (size_t i = 0; i < shardCount; ++i) {
+            shards_.push_back(std::make_unique<Shard>());
+        }
+    }
+
+    std::optional<Value> get(const Key &key) {
+        auto &shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        if (it->second->expires <= Clock::now()) {
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return it->second->value;
+    }
+
+    // Generation of the shard holding key; read it before fetching from the source of truth
+    uint64_t generation(const Key &key) {
+        auto &shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.generation;
+    }
+
+    // Store value unless the shard saw an invalidation since generation was read,
+    // so a slow read can never reinstate a row that a concurrent write already replaced
+    bool put(const Key &key, Value value, std::optional<uint64_t> generation = std::nullopt) {
+        auto &shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (generation && *generation != shard.generation) {
+            return false;
+        }
+        auto expires = Clock::now() + ttl_;
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            it->second->value = std::move(value);
+            it->second->expires = expires;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return true;
+        }
+        shard.lru.push_front(Entry{key, std::move(value), expires});
+        shard.index.emplace(key, shard.lru.begin());
+        if (shard.lru.size() > capacityPerShard_) {
+            shard.index.erase(shard.lru.back().key);
+            shard.lru.pop_back();
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    void erase(const Key &key) {
+        auto &shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ++shard.generation;
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+    }
+
+    void clear() {
+        for (auto &shard: shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            ++shard->generation;
+            shard->index.clear();
+            shard->lru.clear();
+        }
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const auto &shard: shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->lru.size();
+        }
+        return total;
+    }
+
+    size_t capacity() const {
+        return capacityPerShard_ * shards_.size();
+    }
+
+    uint64_t hits() const {
+        return hits_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t misses() const {
+        return misses_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t evictions() const {
+        return evictions_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        Clock::time_point expires;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> lru;
+        std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index;
+        uint64_t generation = 0;
+    };
+
+    Shard &shardFor(const Key &key) {
+        return *shards_[Hash{}(key) % shards_.size()];
+    }
+
+    std::chrono::milliseconds ttl_;
+    size_t capacityPerShard_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Write-behind micro-batching: items added within `window` of the first one in a batch, or until
+// `maxItems` have arrived, are handed to one flush call, and each caller is completed with its own
+// outcome. Safe to use from any thread; callers are completed on the thread that resolves the flush.
+template<typename Item, typename Outcome>
+class MicroBatcher {
+public:
+    using Done = std::function<void(const Outcome &)>;
+    // Receives the outcomes in the order the items were flushed; call it exactly once
+    using Resolve = std::function<void(const std::vector<Outcome> &)>;
+    using Flush = std::function<void(std::vector<Item> &&, Resolve)>;
+    // Runs the callback once the delay has elapsed (an event loop timer in the app, a stub in tests)
+    using Schedule = std::function<void(std::chrono::microseconds, std::function<void()>)>;
+
+    MicroBatcher(size_t maxItems, std::chrono::microseconds window, Flush flush, Schedule schedule)
+        : maxItems_(std::max<size_t>(1, maxItems)), window_(window), flush_(std::move(flush)),
+          schedule_(std::move(schedule)) {
+    }
+
+    void add(Item item, Done done) {
+        std::vector<Item> items;
+        std::vector<Done> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            items_.push_back(std::move(item));
+            waiters_.push_back(std::move(done));
+            if (items_.size() == 1 && maxItems_ > 1) {
+                // the first item of a batch arms its timer; a full batch leaves before it fires
+                auto batch = batch_;
+                schedule_(window_, [this, batch]() { flushBatch(batch); });
+            }
+            if (items_.size() < maxItems_) {
+                return;
+            }
+            take(items, waiters);
+        }
+        flush(std::move(items), std::move(waiters));
+    }
+
+    // batches flushed so far
+    uint64_t batches() const {
+        return batches_.load(std::memory_order_relaxed);
+    }
+
+    // items flushed so far
+    uint64_t items() const {
+        return flushed_.load(std::memory_order_relaxed);
+    }
+
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.size();
+    }
+
+private:
+    // timer callback: flush unless that batch already left because it filled up
+    void flushBatch(uint64_t batch) {
+        std::vector<Item> items;
+        std::vector<Done> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (batch != batch_ || items_.empty()) {
+                return;
+            }
+            take(items, waiters);
+        }
+        flush(std::move(items), std::move(waiters));
+    }
+
+    // called with mutex_ held
+    void take(std::vector<Item> &items, std::vector<Done> &waiters) {
+        items.swap(items_);
+        waiters.swap(waiters_);
+        ++batch_;
+    }
+
+    void flush(std::vector<Item> &&items, std::vector<Done> &&waiters) {
+        batches_.fetch_add(1, std::memory_order_relaxed);
+        flushed_.fetch_add(items.size(), std::memory_order_relaxed);
+        flush_(std::move(items), [waiters = std::move(waiters)](const std::vector<Outcome> &outcomes) {
+            for (size_t i = 0; i < waiters.size() && i < outcomes.size(); ++i) {
+                waiters[i](outcomes[i]);
+            }
+        });
+    }
+
+    const size_t maxItems_;
+    const std::chrono::microseconds window_;
+    Flush flush_;
+    Schedule schedule_;
+    mutable std::mutex mutex_;
+    std::vector<Item> items_;
+    std::vector<Done> waiters_;
+    uint64_t batch_ = 0;
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> flushed_{0};
+};
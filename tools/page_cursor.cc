@@ -0,0 +1,139 @@
+#include "page_cursor.h"
+#include <charconv>
+#include <cmath>
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static std::string hex_encode(const std::string &raw) {
+    std::string token;
+    token.reserve(raw.size() * 2);
+    for (unsigned char c: raw) {
+        token += hex_digits[c >> 4];
+        token += hex_digits[c & 0x0f];
+    }
+    return token;
+}
+
+static std::optional<std::string> hex_decode(const std::string &token) {
+    if (token.empty() || token.size() % 2 != 0) {
+        return std::nullopt;
+    }
+
+    std::string raw;
+    raw.reserve(token.size() / 2);
+    for (size_t i = 0; i < token.size(); i += 2) {
+        int hi = hex_value(token[i]);
+        int lo = hex_value(token[i + 1]);
+        if (hi < 0 || lo < 0) {
+            return std::nullopt;
+        }
+        raw += static_cast<char>((hi << 4) | lo);
+    }
+    return raw;
+}
+
+static bool parse_id(const char *first, const char *last, int32_t &id) {
+    auto [ptr, ec] = std::from_chars(first, last, id);
+    return ec == std::errc() && ptr == last && first != last;
+}
+
+std::string encode_page_cursor(const PageCursor &cursor) {
+    return hex_encode(cursor.created_at + "|" + std::to_string(cursor.id));
+}
+
+std::optional<PageCursor> decode_page_cursor(const std::string &token) {
+    auto decoded = hex_decode(token);
+    if (!decoded) {
+        return std::nullopt;
+    }
+    const auto &raw = *decoded;
+
+    auto sep = raw.rfind('|');
+    if (sep == std::string::npos || sep == 0) {
+        return std::nullopt;
+    }
+
+    PageCursor cursor;
+    cursor.created_at = raw.substr(0, sep);
+    // only characters Postgres prints in a timestamp, the value is bound as a query parameter anyway
+    for (char c: cursor.created_at) {
+        if (!((c >= '0' && c <= '9') || c == '-' || c == ':' || c == '.' || c == ' ' || c == '+')) {
+            return std::nullopt;
+        }
+    }
+
+    if (!parse_id(raw.data() + sep + 1, raw.data() + raw.size(), cursor.id)) {
+        return std::nullopt;
+    }
+    return cursor;
+}
+
+// "s|<rank>|<id>": the prefix keeps search and listing cursors from being mistaken for each other
+std::string encode_search_cursor(const SearchCursor &cursor) {
+    char rank[32];
+    auto [end, ec] = std::to_chars(rank, rank + sizeof(rank), cursor.rank);
+    (void)ec;
+    return hex_encode("s|" + std::string(rank, end) + "|" + std::to_string(cursor.id));
+}
+
+std::optional<SearchCursor> decode_search_cursor(const std::string &token) {
+    auto decoded = hex_decode(token);
+    if (!decoded || decoded->size() < 2 || decoded->compare(0, 2, "s|") != 0) {
+        return std::nullopt;
+    }
+    const auto &raw = *decoded;
+    auto sep = raw.rfind('|');
+    if (sep <= 2) {
+        return std::nullopt;
+    }
+
+    SearchCursor cursor;
+    const char *first = raw.data() + 2;
+    const char *last = raw.data() + sep;
+    auto [ptr, ec] = std::from_chars(first, last, cursor.rank);
+    if (ec != std::errc() || ptr != last || !(cursor.rank >= 0)) {
+        return std::nullopt;
+    }
+    if (!parse_id(raw.data() + sep + 1, raw.data() + raw.size(), cursor.id)) {
+        return std::nullopt;
+    }
+    return cursor;
+}
+
+// "o|<key>|<id>", shortest round-trip form of the key
+std::string encode_sort_cursor(const SortCursor &cursor) {
+    char key[32];
+    auto [end, ec] = std::to_chars(key, key + sizeof(key), cursor.key);
+    (void)ec;
+    return hex_encode("o|" + std::string(key, end) + "|" + std::to_string(cursor.id));
+}
+
+std::optional<SortCursor> decode_sort_cursor(const std::string &token) {
+    auto decoded = hex_decode(token);
+    if (!decoded || decoded->size() < 2 || decoded->compare(0, 2, "o|") != 0) {
+        return std::nullopt;
+    }
+    const auto &raw = *decoded;
+    auto sep = raw.rfind('|');
+    if (sep <= 2) {
+        return std::nullopt;
+    }
+
+    SortCursor cursor;
+    const char *first = raw.data() + 2;
+    const char *last = raw.data() + sep;
+    auto [ptr, ec] = std::from_chars(first, last, cursor.key);
+    if (ec != std::errc() || ptr != last || !std::isfinite(cursor.key)) {
+        return std::nullopt;
+    }
+    if (!parse_id(raw.data() + sep + 1, raw.data() + raw.size(), cursor.id)) {
+        return std::nullopt;
+    }
+    return cursor;
+}
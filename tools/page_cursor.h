@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Last row of a keyset page ordered by (created_at, id)
+struct PageCursor {
+    std::string created_at; // timestamp text exactly as returned by Postgres
+    int32_t id = 0;
+};
+
+// Opaque, URL-safe token handed to clients as next_cursor
+std::string encode_page_cursor(const PageCursor &cursor);
+
+// Returns std::nullopt for tokens that were not produced by encode_page_cursor
+std::optional<PageCursor> decode_page_cursor(const std::string &token);
+
+// Last row of a search page ordered by (rank, id)
+struct SearchCursor {
+    float rank = 0; // ts_rank_cd is a real; printed with enough digits to compare equal after the round trip
+    int32_t id = 0;
+};
+
+std::string encode_search_cursor(const SearchCursor &cursor);
+
+// Returns std::nullopt for tokens that were not produced by encode_search_cursor
+std::optional<SearchCursor> decode_search_cursor(const std::string &token);
+
+// Last row of a filtered listing page, in whichever order it was sorted
+struct SortCursor {
+    double key = 0; // price, or created_at in microseconds for the newest-first order
+    int32_t id = 0;
+};
+
+std::string encode_sort_cursor(const SortCursor &cursor);
+
+// Returns std::nullopt for tokens that were not produced by encode_sort_cursor
+std::optional<SortCursor> decode_sort_cursor(const std::string &token);
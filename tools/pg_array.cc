@@ -0,0 +1,28 @@
+#include "pg_array.h"
+
+std::string to_pg_array_literal(const std::vector<std::string> &values) {
+    size_t size = 2;
+    for (const auto &value: values) {
+        size += value.size() + 3;
+    }
+
+    std::string literal;
+    literal.reserve(size);
+    literal += '{';
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) {
+            literal += ',';
+        }
+        // every element is quoted, so only the quote and the escape character need escaping
+        literal += '"';
+        for (char c: values[i]) {
+            if (c == '"' || c == '\\') {
+                literal += '\\';
+            }
+            literal += c;
+        }
+        literal += '"';
+    }
+    literal += '}';
+    return literal;
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Text form of a Postgres array ('{"a","b"}'), used to bind a whole column of values as one parameter
+std::string to_pg_array_literal(const std::vector<std::string> &values);
@@ -0,0 +1,37 @@
+#include "pg_lsn.h"
+#include <charconv>
+
+static bool parse_hex_half(const char *first, const char *last, uint32_t &value) {
+    if (first == last || last - first > 8) {
+        return false;
+    }
+    auto [ptr, ec] = std::from_chars(first, last, value, 16);
+    return ec == std::errc() && ptr == last;
+}
+
+std::optional<uint64_t> parse_pg_lsn(const std::string &text) {
+    auto slash = text.find('/');
+    if (slash == std::string::npos) {
+        return std::nullopt;
+    }
+    uint32_t hi = 0, lo = 0;
+    const char *begin = text.data();
+    if (!parse_hex_half(begin, begin + slash, hi) || !parse_hex_half(begin + slash + 1, begin + text.size(), lo)) {
+        return std::nullopt;
+    }
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+std::string format_pg_lsn(uint64_t lsn) {
+    char buffer[20];
+    auto hi = std::to_chars(buffer, buffer + 8, static_cast<uint32_t>(lsn >> 32), 16).ptr;
+    *hi = '/';
+    auto end = std::to_chars(hi + 1, buffer + sizeof(buffer), static_cast<uint32_t>(lsn), 16).ptr;
+    std::string text(buffer, end);
+    for (auto &c: text) {
+        if (c >= 'a' && c <= 'f') {
+            c = static_cast<char>(c - 'a' + 'A');
+        }
+    }
+    return text;
+}
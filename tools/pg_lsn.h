@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// PostgreSQL WAL positions ("16/B374D848") as comparable integers; they are handed to clients as
+// read-your-writes tokens and compared against what each replica has replayed
+
+// Returns std::nullopt for text that is not an LSN
+std::optional<uint64_t> parse_pg_lsn(const std::string &text);
+
+std::string format_pg_lsn(uint64_t lsn);
@@ -0,0 +1,42 @@
+#include "pool_scaler.h"
+#include <algorithm>
+
+PoolScaler::PoolScaler(const Options &options) : options_(options) {
+    options_.minSize = std::max<size_t>(1, options_.minSize);
+    options_.maxSize = std::max(options_.minSize, options_.maxSize);
+}
+
+int PoolScaler::decide(const Sample &sample) {
+    if (sample.size < options_.minSize) {
+        quietIntervals_ = 0;
+        return static_cast<int>(options_.minSize - sample.size);
+    }
+    if (sample.size > options_.maxSize) {
+        quietIntervals_ = 0;
+        return -static_cast<int>(sample.size - options_.maxSize);
+    }
+
+    bool queued = sample.peakWaiting >= options_.growQueueDepth ||
+                  (sample.peakWaiting > 0 && sample.waitP95Ms >= options_.growWaitMs);
+    if (queued) {
+        quietIntervals_ = 0;
+        // more connections would only add load to a server that is already slow to answer
+        if (sample.queryP95Ms > options_.maxQueryMs) {
+            return 0;
+        }
+        // at most double per interval, so one burst does not open every connection at once
+        auto wanted = std::clamp<size_t>(sample.peakWaiting, 1, sample.size);
+        return static_cast<int>(std::min(wanted, options_.maxSize - sample.size));
+    }
+
+    auto busy = static_cast<double>(sample.peakInUse + sample.peakWaiting);
+    if (sample.size > options_.minSize && busy <= static_cast<double>(sample.size) * options_.shrinkUtilization) {
+        if (++quietIntervals_ >= options_.shrinkAfter) {
+            quietIntervals_ = 0;
+            return -1;
+        }
+        return 0;
+    }
+    quietIntervals_ = 0;
+    return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+
+// Sizing policy of the adaptive db pool (tools/db_pool.h). Called once per scaling interval with what the
+// pool saw during that interval; it grows the pool while queries queue for a connection and shrinks it one
+// connection at a time after a sustained quiet period, always within [minSize, maxSize].
+class PoolScaler {
+public:
+    struct Options {
+        size_t minSize = 1;
+        size_t maxSize = 16;
+        size_t growQueueDepth = 2; // queued queries that always warrant another connection
+        double growWaitMs = 5;     // p95 queue wait that warrants one even with a shorter queue
+        double maxQueryMs = 250;   // above this p95 query time the server is the bottleneck: hold the size
+        double shrinkUtilization = 0.5;
+        size_t shrinkAfter = 20; // consecutive quiet intervals before a connection is closed
+    };
+
+    struct Sample {
+        size_t size = 0;
+        size_t peakInUse = 0;
+        size_t peakWaiting = 0;
+        double waitP95Ms = 0;
+        double queryP95Ms = 0;
+    };
+
+    explicit PoolScaler(const Options &options);
+
+    // Connections to open (positive) or close (negative)
+    int decide(const Sample &sample);
+
+    const Options &options() const {
+        return options_;
+    }
+
+private:
+    Options options_;
+    size_t quietIntervals_ = 0;
+};
@@ -0,0 +1,129 @@
+#include "posting_list.h"
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    void putVarint(std::vector<uint8_t> &bytes, uint32_t value) {
+        while (value >= 0x80) {
+            bytes.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint32_t getVarint(const uint8_t *&p) {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = *p++;
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+    }
+}
+
+PostingList::PostingList(const std::vector<uint32_t> &sortedIds) : size_(sortedIds.size()) {
+    blocks_.reserve((sortedIds.size() + kBlockSize - 1) / kBlockSize);
+    for (size_t start = 0; start < sortedIds.size(); start += kBlockSize) {
+        auto end = std::min(start + kBlockSize, sortedIds.size());
+        blocks_.push_back({sortedIds[start], sortedIds[end - 1], static_cast<uint32_t>(bytes_.size()),
+                           static_cast<uint32_t>(end - start)});
+        for (size_t i = start + 1; i < end; ++i) {
+            putVarint(bytes_, sortedIds[i] - sortedIds[i - 1]);
+        }
+    }
+    bytes_.shrink_to_fit();
+}
+
+void PostingList::decodeBlock(const Block &block, std::vector<uint32_t> &out) const {
+    const uint8_t *p = bytes_.data() + block.offset;
+    uint32_t id = block.first;
+    out.push_back(id);
+    for (uint32_t i = 1; i < block.count; ++i) {
+        id += getVarint(p);
+        out.push_back(id);
+    }
+}
+
+void PostingList::decode(std::vector<uint32_t> &out) const {
+    out.reserve(out.size() + size_);
+    for (const auto &block: blocks_) {
+        decodeBlock(block, out);
+    }
+}
+
+void PostingList::decodeRange(uint32_t lo, uint32_t hi, std::vector<uint32_t> &out) const {
+    auto it = std::lower_bound(blocks_.begin(), blocks_.end(), lo,
+                               [](const Block &block, uint32_t id) { return block.last < id; });
+    for (; it != blocks_.end() && it->first <= hi; ++it) {
+        decodeBlock(*it, out);
+    }
+}
+
+size_t intersect_sorted(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out) {
+    size_t i = 0, j = 0, k = 0;
+#if defined(__SSE2__)
+    // all-pairs compare of a four-id window of a against one of b; the window with the smaller
+    // last id cannot match anything further on, so it moves ahead
+    size_t na4 = na & ~size_t(3), nb4 = nb & ~size_t(3);
+    while (i < na4 && j < nb4) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+        __m128i eq = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        for (int lane = 0; lane < 4; ++lane) {
+            if (mask & (1 << lane)) {
+                out[k++] = a[i + static_cast<size_t>(lane)];
+            }
+        }
+        uint32_t lastA = a[i + 3], lastB = b[j + 3];
+        if (lastA <= lastB) {
+            i += 4;
+        }
+        if (lastB <= lastA) {
+            j += 4;
+        }
+    }
+#endif
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            ++i;
+        } else if (b[j] < a[i]) {
+            ++j;
+        } else {
+            out[k++] = a[i];
+            ++i;
+            ++j;
+        }
+    }
+    return k;
+}
+
+size_t union_sorted(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            out[k++] = a[i++];
+        } else if (b[j] < a[i]) {
+            out[k++] = b[j++];
+        } else {
+            out[k++] = a[i];
+            ++i;
+            ++j;
+        }
+    }
+    while (i < na) {
+        out[k++] = a[i++];
+    }
+    while (j < nb) {
+        out[k++] = b[j++];
+    }
+    return k;
+}
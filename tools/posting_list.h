@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sorted product ids of one search term, stored as varint-encoded gaps in blocks of kBlockSize ids.
+// Every block keeps its first and last id, so an intersection only decodes the blocks that can overlap
+// the ids it is still looking for.
+class PostingList {
+public:
+    static constexpr size_t kBlockSize = 128;
+
+    PostingList() = default;
+
+    // sortedIds must be strictly increasing
+    explicit PostingList(const std::vector<uint32_t> &sortedIds);
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Encoded size, block index included
+    size_t bytes() const {
+        return bytes_.size() + blocks_.size() * sizeof(Block);
+    }
+
+    // Appends every id
+    void decode(std::vector<uint32_t> &out) const;
+
+    // Appends the ids of every block that overlaps [lo, hi]; ids outside the range may be included
+    void decodeRange(uint32_t lo, uint32_t hi, std::vector<uint32_t> &out) const;
+
+private:
+    struct Block {
+        uint32_t first;
+        uint32_t last;
+        uint32_t offset; // into bytes_, where the gaps after `first` start
+        uint32_t count;
+    };
+
+    void decodeBlock(const Block &block, std::vector<uint32_t> &out) const;
+
+    std::vector<Block> blocks_;
+    std::vector<uint8_t> bytes_;
+    size_t size_ = 0;
+};
+
+// Ids in both a and b (strictly increasing inputs), written to out, which must have room for min(na, nb).
+// Compares four ids against four at a time with SSE2 where the target has it. Returns the count written.
+size_t intersect_sorted(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out);
+
+// Ids in a or b (strictly increasing inputs), written to out, which must have room for na + nb.
+// Returns the count written.
+size_t union_sorted(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out);
@@ -0,0 +1,148 @@
+#include "prefix_index.h"
+#include <algorithm>
+#include <deque>
+
+namespace {
+    bool isWordByte(unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+    }
+
+    // key starts at the beginning of text or right after a space in it
+    bool hasWordPrefix(const std::string &text, const std::string &key) {
+        for (auto at = text.find(key); at != std::string::npos; at = text.find(key, at + 1)) {
+            if (at == 0 || text[at - 1] == ' ') {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+std::string PrefixIndex::normalize(std::string_view text) {
+    std::string out;
+    out.reserve(text.size());
+    bool gap = false;
+    for (unsigned char c: text) {
+        if (!isWordByte(c)) {
+            gap = !out.empty();
+            continue;
+        }
+        if (gap) {
+            out += ' ';
+            gap = false;
+        }
+        out += (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : static_cast<char>(c);
+    }
+    return out;
+}
+
+PrefixIndex::PrefixIndex(std::vector<Entry> entries, size_t topK) : entries_(std::move(entries)), topK_(topK) {
+    // best first, so an entry's index is its rank and a top list is just the smallest indices
+    std::sort(entries_.begin(), entries_.end(), [](const Entry &a, const Entry &b) {
+        return a.score != b.score ? a.score > b.score : a.id > b.id;
+    });
+    keys_.reserve(entries_.size());
+    std::vector<std::pair<uint32_t, uint32_t>> suffixes; // (entry, offset of a word in its key)
+    for (uint32_t e = 0; e < entries_.size(); ++e) {
+        keys_.push_back(normalize(entries_[e].title));
+        const auto &key = keys_.back();
+        for (size_t i = 0; i < key.size(); ++i) {
+            if (i == 0 || key[i - 1] == ' ') {
+                suffixes.emplace_back(e, static_cast<uint32_t>(i));
+            }
+        }
+    }
+    auto text = [this](const std::pair<uint32_t, uint32_t> &suffix) {
+        return std::string_view(keys_[suffix.first]).substr(suffix.second);
+    };
+    std::sort(suffixes.begin(), suffixes.end(),
+              [&text](const auto &a, const auto &b) { return text(a) < text(b); });
+
+    // Breadth first over ranges of sorted suffixes sharing `depth` leading bytes, so that siblings end up
+    // next to each other
+    struct Range {
+        size_t lo, hi, depth;
+    };
+    std::deque<Range> queue{{0, suffixes.size(), 0}};
+    std::vector<uint32_t> best;
+    uint32_t assigned = 1;
+    while (!queue.empty()) {
+        auto [lo, hi, depth] = queue.front();
+        queue.pop_front();
+
+        // the K + 1 best distinct entries: one more than K says whether the node needs children
+        best.clear();
+        for (auto i = lo; i < hi; ++i) {
+            auto entry = suffixes[i].first;
+            if (best.size() > topK_ && entry >= best.back()) {
+                continue;
+            }
+            auto it = std::lower_bound(best.begin(), best.end(), entry);
+            if (it != best.end() && *it == entry) {
+                continue;
+            }
+            best.insert(it, entry);
+            if (best.size() > topK_ + 1) {
+                best.pop_back();
+            }
+        }
+        topBegin_.push_back(static_cast<uint32_t>(top_.size()));
+        top_.insert(top_.end(), best.begin(), best.begin() + std::min(best.size(), topK_));
+        childBegin_.push_back(static_cast<uint32_t>(labels_.size()));
+        if (best.size() <= topK_ || depth == kMaxDepth) {
+            continue;
+        }
+
+        // suffixes ending at depth sort first and stay with this node
+        auto i = lo;
+        while (i < hi && text(suffixes[i]).size() == depth) {
+            ++i;
+        }
+        while (i < hi) {
+            auto label = static_cast<unsigned char>(text(suffixes[i])[depth]);
+            auto j = i + 1;
+            while (j < hi && static_cast<unsigned char>(text(suffixes[j])[depth]) == label) {
+                ++j;
+            }
+            labels_.push_back(label);
+            targets_.push_back(assigned++);
+            queue.push_back({i, j, depth + 1});
+            i = j;
+        }
+    }
+    childBegin_.push_back(static_cast<uint32_t>(labels_.size()));
+    topBegin_.push_back(static_cast<uint32_t>(top_.size()));
+}
+
+std::vector<const PrefixIndex::Entry *> PrefixIndex::suggest(std::string_view prefix, size_t limit) const {
+    std::vector<const Entry *> out;
+    auto key = normalize(prefix);
+    if (key.empty() || childBegin_.empty() || limit == 0) {
+        return out;
+    }
+    uint32_t node = 0;
+    size_t depth = 0;
+    for (; depth < key.size() && childBegin_[node] != childBegin_[node + 1]; ++depth) {
+        auto begin = labels_.begin() + childBegin_[node];
+        auto end = labels_.begin() + childBegin_[node + 1];
+        auto it = std::lower_bound(begin, end, static_cast<unsigned char>(key[depth]));
+        if (it == end || *it != static_cast<unsigned char>(key[depth])) {
+            return out;
+        }
+        node = targets_[it - labels_.begin()];
+    }
+    // stopped early at a node without children: its top list holds every candidate
+    bool filter = depth < key.size();
+    for (auto i = topBegin_[node]; i < topBegin_[node + 1] && out.size() < limit; ++i) {
+        if (filter && !hasWordPrefix(keys_[top_[i]], key)) {
+            continue;
+        }
+        out.push_back(&entries_[top_[i]]);
+    }
+    return out;
+}
+
+size_t PrefixIndex::bytes() const {
+    return childBegin_.size() * sizeof(uint32_t) + labels_.size() + targets_.size() * sizeof(uint32_t) +
+           topBegin_.size() * sizeof(uint32_t) + top_.size() * sizeof(uint32_t);
+}
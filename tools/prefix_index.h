@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable typeahead index over product titles. Every title is keyed by its normalised text and by the
+// text from each later word on, so "iph" finds "Apple iPhone 15". The keys are sorted and a trie is laid
+// over them in a few contiguous arrays (children sorted by label), each node carrying its precomputed
+// top-K entries. A node whose keys belong to at most K titles gets no children: its top list already holds
+// every title below it, and a longer prefix just filters those. So a lookup is a short walk plus at most K
+// candidates, whatever the catalog size, and the trie only grows where titles actually crowd together.
+// Built once and never modified; a rebuilt index replaces the old one wholesale.
+class PrefixIndex {
+public:
+    // Deepest trie level; only when more than K titles share a prefix this long can a longer prefix come
+    // back with fewer than `limit` results
+    static constexpr size_t kMaxDepth = 64;
+
+    struct Entry {
+        uint32_t id = 0;
+        std::string title;
+        uint64_t score = 0; // popularity, higher first; ties go to the newer id
+    };
+
+    PrefixIndex() = default;
+    PrefixIndex(std::vector<Entry> entries, size_t topK);
+
+    // Lowercased ASCII, runs of anything that is not a letter or digit (bytes >= 0x80 are kept) become one
+    // space, no leading/trailing space
+    static std::string normalize(std::string_view text);
+
+    // Best entries whose title, or a word of it onwards, starts with prefix
+    std::vector<const Entry *> suggest(std::string_view prefix, size_t limit) const;
+
+    size_t size() const {
+        return entries_.size();
+    }
+
+    const std::vector<Entry> &entries() const {
+        return entries_;
+    }
+
+    size_t nodes() const {
+        return childBegin_.empty() ? 0 : childBegin_.size() - 1;
+    }
+
+    size_t topK() const {
+        return topK_;
+    }
+
+    // Trie arrays only, not the titles
+    size_t bytes() const;
+
+private:
+    std::vector<Entry> entries_; // best first
+    std::vector<std::string> keys_; // normalised titles, same order
+    size_t topK_ = 0;
+    // node n's children are labels_/targets_[childBegin_[n], childBegin_[n + 1]); node 0 is the root
+    std::vector<uint32_t> childBegin_;
+    std::vector<unsigned char> labels_;
+    std::vector<uint32_t> targets_;
+    // node n's best entries are top_[topBegin_[n], topBegin_[n + 1]), as indices into entries_
+    std::vector<uint32_t> topBegin_;
+    std::vector<uint32_t> top_;
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Read-mostly publication of an immutable value: a writer builds a new T off to the side and publishes it,
+// readers on any thread pick up whole versions. Each reader thread caches the shared_ptr it last saw together
+// with its version, so a load() is a single atomic read of the version while nothing changed. The first load()
+// after a publish copies the current shared_ptr through an atomic pointer; readers never take a lock.
+// publish() swaps the pointer and retires the old shared_ptr object, which is deleted once no reader is in the
+// middle of copying one: by that publish() or, when a copy was under way, by the reader finishing last.
+// A thread keeps the version it last loaded alive until its next load(), and whoever drops the last reference
+// to an old version frees it (which may be a large T) without holding anything other threads wait on.
+template<typename T>
+class RcuSnapshot {
+public:
+    RcuSnapshot() = default;
+    RcuSnapshot(const RcuSnapshot &) = delete;
+    RcuSnapshot &operator=(const RcuSnapshot &) = delete;
+
+    ~RcuSnapshot() {
+        delete current_.load();
+        for (auto *retired: retired_) {
+            delete retired;
+        }
+    }
+
+    // Null until the first publish
+    std::shared_ptr<const T> load() const {
+        thread_local Cached cached;
+        auto version = version_.load(std::memory_order_acquire);
+        if (cached.version != version) {
+            auto previous = std::move(cached.value);
+            copying_.fetch_add(1);
+            // at least as new as version: its pointer was stored before version was
+            if (auto *current = current_.load()) {
+                cached.value = *current;
+            }
+            if (copying_.fetch_sub(1) == 1 && retiring_.load()) {
+                reclaim();
+            }
+            cached.version = version;
+        }
+        return cached.value;
+    }
+
+    void publish(std::shared_ptr<const T> value) {
+        auto *next = new std::shared_ptr<const T>(std::move(value));
+        {
+            std::lock_guard<std::mutex> lock(publishMutex_);
+            if (auto *previous = current_.exchange(next)) {
+                retired_.push_back(previous);
+                retiring_.store(true);
+            }
+            version_.store(nextVersion(), std::memory_order_release);
+        }
+        publishes_.fetch_add(1, std::memory_order_relaxed);
+        reclaim();
+    }
+
+    uint64_t publishes() const {
+        return publishes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Cached {
+        uint64_t version = 0;
+        std::shared_ptr<const T> value;
+    };
+
+    // unique across every RcuSnapshot<T>, so a thread's cached entry can never pass for another instance's
+    static uint64_t nextVersion() {
+        static std::atomic<uint64_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Deletes the retired pointers when no reader is copying; a reader that starts afterwards can only see the
+    // current one. Never waits: if a publish() holds the mutex, that publish() reclaims after it.
+    void reclaim() const {
+        std::vector<std::shared_ptr<const T> *> retired;
+        {
+            std::unique_lock<std::mutex> lock(publishMutex_, std::try_to_lock);
+            if (!lock || copying_.load() != 0) {
+                return;
+            }
+            retired.swap(retired_);
+            retiring_.store(false);
+        }
+        // old versions are released here, outside the lock
+        for (auto *pointer: retired) {
+            delete pointer;
+        }
+    }
+
+    std::atomic<std::shared_ptr<const T> *> current_{nullptr};
+    mutable std::atomic<uint32_t> copying_{0}; // readers between loading current_ and copying what it points to
+    mutable std::mutex publishMutex_;          // publishers, and reclaim()
+    mutable std::vector<std::shared_ptr<const T> *> retired_;
+    mutable std::atomic<bool> retiring_{false};
+    std::atomic<uint64_t> version_{0};
+    std::atomic<uint64_t> publishes_{0};
+};
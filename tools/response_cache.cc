@@ -0,0 +1,73 @@
+#include "response_cache.h"
+#include <drogon/drogon.h>
+#include <drogon/utils/Utilities.h>
+#include <fmt/format.h>
+
+ResponseCache::ResponseCache(size_t capacity, std::chrono::milliseconds ttl)
+    : entries_(capacity, ttl, 4), instanceId_(drogon::utils::getUuid().substr(0, 8)) {
+}
+
+std::string ResponseCache::etagFor(uint64_t version, const std::string &key) const {
+    return fmt::format("\"{}-{}-{:016x}\"", instanceId_, version, std::hash<std::string>{}(key));
+}
+
+bool ResponseCache::notModified(const drogon::HttpRequestPtr &req, const std::string &etag) {
+    const auto &ifNoneMatch = req->getHeader("If-None-Match");
+    if (ifNoneMatch.empty()) {
+        return false;
+    }
+    return ifNoneMatch == "*" || ifNoneMatch.find(etag) != std::string::npos;
+}
+
+drogon::HttpResponsePtr ResponseCache::newNotModifiedResponse(const std::string &etag) {
+    auto resp = drogon::HttpResponse::newHttpResponse();
+    resp->setStatusCode(drogon::k304NotModified);
+    resp->addHeader("ETag", etag);
+    return resp;
+}
+
+std::shared_ptr<const CachedResponse> ResponseCache::find(const std::string &key) {
+    auto entry = entries_.get(key);
+    if (!entry || (*entry)->version != version()) {
+        return nullptr;
+    }
+    return *entry;
+}
+
+std::shared_ptr<const CachedResponse> ResponseCache::store(const std::string &key, uint64_t version,
+                                                           std::string body) {
+    auto entry = std::make_shared<CachedResponse>();
+    entry->version = version;
+    entry->etag = etagFor(version, key);
+    if (drogon::app().isGzipEnabled()) {
+        entry->gzip = drogon::utils::gzipCompress(body.data(), body.size());
+    }
+    if (drogon::app().isBrotliEnabled()) {
+        entry->brotli = drogon::utils::brotliCompress(body.data(), body.size());
+    }
+    entry->body = std::move(body);
+    if (version == this->version()) {
+        entries_.put(key, entry);
+    }
+    return entry;
+}
+
+drogon::HttpResponsePtr ResponseCache::toResponse(const CachedResponse &entry, const drogon::HttpRequestPtr &req) {
+    const auto &acceptEncoding = req->getHeader("Accept-Encoding");
+    auto resp = drogon::HttpResponse::newHttpResponse();
+    resp->setStatusCode(drogon::k200OK);
+    resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+    resp->addHeader("ETag", entry.etag);
+    resp->addHeader("Vary", "Accept-Encoding");
+    // a response that already carries Content-Encoding is sent as is by drogon
+    if (!entry.brotli.empty() && acceptEncoding.find("br") != std::string::npos) {
+        resp->addHeader("Content-Encoding", "br");
+        resp->setBody(entry.brotli);
+    } else if (!entry.gzip.empty() && acceptEncoding.find("gzip") != std::string::npos) {
+        resp->addHeader("Content-Encoding", "gzip");
+        resp->setBody(entry.gzip);
+    } else {
+        resp->setBody(entry.body);
+    }
+    return resp;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include "lru_cache.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+// One serialised response body, pre-compressed once so hits are a memory copy
+struct CachedResponse {
+    uint64_t version = 0;
+    std::string etag;
+    std::string body;
+    std::string gzip;   // empty when gzip is disabled in config.json
+    std::string brotli; // empty when brotli is disabled in config.json
+};
+
+// Whole-response cache for a resource that changes rarely and is read often.
+// Entries are tagged with the version counter at the time the data was read and only served while it is current;
+// writers call bumpVersion() so that every entry and every ETag issued before the write goes stale at once.
+class ResponseCache {
+public:
+    ResponseCache(size_t capacity, std::chrono::milliseconds ttl);
+
+    uint64_t version() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    void bumpVersion() {
+        version_.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    // Strong validator for the representation of key at version, unique across restarts and instances
+    std::string etagFor(uint64_t version, const std::string &key) const;
+
+    // True when the request's If-None-Match already names etag
+    static bool notModified(const drogon::HttpRequestPtr &req, const std::string &etag);
+
+    static drogon::HttpResponsePtr newNotModifiedResponse(const std::string &etag);
+
+    // Entry for key, or nullptr when there is none for the current version
+    std::shared_ptr<const CachedResponse> find(const std::string &key);
+
+    // Compress and keep body; the entry is dropped right away if the version moved while the data was read
+    std::shared_ptr<const CachedResponse> store(const std::string &key, uint64_t version, std::string body);
+
+    // 200 response carrying the best encoding the client accepts
+    static drogon::HttpResponsePtr toResponse(const CachedResponse &entry, const drogon::HttpRequestPtr &req);
+
+    uint64_t hits() const {
+        return entries_.hits();
+    }
+
+    uint64_t misses() const {
+        return entries_.misses();
+    }
+
+    size_t size() const {
+        return entries_.size();
+    }
+
+private:
+    ShardedLruCache<std::string, std::shared_ptr<const CachedResponse>> entries_;
+    std::atomic<uint64_t> version_{0};
+    std::string instanceId_;
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Request coalescing: concurrent calls for the same key share one in-flight fetch.
+// Safe to use from any thread; waiters are completed on the thread that resolves the fetch.
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class SingleFlight {
+public:
+    using Waiter = std::function<void(const Value &)>;
+    using Resolve = std::function<void(const Value &)>;
+    // Value handed to the waiters when fetch throws before resolving
+    using Fail = std::function<Value(std::exception_ptr)>;
+
+    // Join the call in flight for key, or lead a new one by running fetch.
+    // fetch gets the resolver that completes every waiter and must call it exactly once; if it throws instead,
+    // the key is released so the next call fetches again and the waiters get fail(exception) (Value{} without fail)
+    void run(const Key &key, Waiter &&waiter, const std::function<void(Resolve)> &fetch, const Fail &fail = {}) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = calls_.find(key);
+            if (it != calls_.end()) {
+                it->second.push_back(std::move(waiter));
+                ++joined_;
+                return;
+            }
+            calls_[key].push_back(std::move(waiter));
+        }
+        ++led_;
+
+        try {
+            fetch([this, key](const Value &value) {
+                for (auto &w: take(key)) {
+                    w(value);
+                }
+            });
+        } catch (...) {
+            auto waiters = take(key);
+            if (waiters.empty()) {
+                // already resolved, the exception came from a waiter or from after the resolve
+                throw;
+            }
+            auto value = fail ? fail(std::current_exception()) : Value{};
+            for (auto &w: waiters) {
+                w(value);
+            }
+        }
+    }
+
+    // fetches actually issued
+    uint64_t led() const {
+        return led_.load(std::memory_order_relaxed);
+    }
+
+    // calls that piggybacked on a fetch already in flight
+    uint64_t joined() const {
+        return joined_.load(std::memory_order_relaxed);
+    }
+
+    size_t inFlight() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return calls_.size();
+    }
+
+private:
+    // Waiters of the call for key, which is no longer in flight afterwards; empty if it already completed
+    std::vector<Waiter> take(const Key &key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = calls_.find(key);
+        if (it == calls_.end()) {
+            return {};
+        }
+        auto waiters = std::move(it->second);
+        calls_.erase(it);
+        return waiters;
+    }
+
+    mutable std::mutex mutex_;
+    std::unordered_map<Key, std::vector<Waiter>, Hash> calls_;
+    std::atomic<uint64_t> led_{0};
+    std::atomic<uint64_t> joined_{0};
+};
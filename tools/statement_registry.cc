@@ -0,0 +1,210 @@
+#include "statement_registry.h"
+#include <drogon/drogon.h>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+using namespace drogon::orm;
+
+StatementRegistry &StatementRegistry::instance() {
+    static StatementRegistry registry;
+    return registry;
+}
+
+const PreparedStatement &StatementRegistry::add(std::string name, std::string sql,
+                                                std::function<void(PreparedStatement::Binder &)> bindWarmUpArgs) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = statements_.find(name);
+    if (it != statements_.end()) {
+        if (it->second->sql != sql) {
+            throw std::logic_error("Statement " + name + " registered twice with different SQL");
+        }
+        return *it->second;
+    }
+    auto statement = std::make_unique<PreparedStatement>();
+    statement->name = name;
+    statement->sql = std::move(sql);
+    statement->bindWarmUpArgs = std::move(bindWarmUpArgs);
+    return *statements_.emplace(std::move(name), std::move(statement)).first->second;
+}
+
+const PreparedStatement &StatementRegistry::get(const std::string &name) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = statements_.find(name);
+    if (it == statements_.end()) {
+        throw std::out_of_range("Unknown statement " + name);
+    }
+    return *it->second;
+}
+
+const PreparedStatement &StatementRegistry::getOrAdd(const std::string &name,
+                                                     const std::function<std::string()> &makeSql) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = statements_.find(name);
+        if (it != statements_.end()) {
+            return *it->second;
+        }
+    }
+    return add(name, makeSql());
+}
+
+std::vector<std::string> StatementRegistry::names() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<std::string> result;
+    result.reserve(statements_.size());
+    for (const auto &entry: statements_) {
+        result.push_back(entry.first);
+    }
+    return result;
+}
+
+size_t StatementRegistry::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return statements_.size();
+}
+
+namespace {
+    // Shared by the warm-up transactions; they all stay open until every one has run its statements,
+    // which is what forces the pool to hand each of them a different connection
+    struct WarmUpState {
+        std::mutex mutex;
+        DbClientPtr client;
+        std::vector<const PreparedStatement *> statements;
+        std::vector<std::shared_ptr<Transaction>> transactions;
+        size_t pendingConnections = 0;
+        size_t failed = 0;
+        size_t prepared = 0;
+        bool finished = false;
+        std::function<void(size_t, size_t)> done;
+
+        void finish(size_t extraFailures) {
+            std::vector<std::shared_ptr<Transaction>> held;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (finished) {
+                    return;
+                }
+                finished = true;
+                failed += extraFailures;
+                held.swap(transactions);
+            }
+            // prepared statements outlive the rollback, the rows written by the warm-up do not
+            for (auto &transaction: held) {
+                transaction->rollback();
+            }
+            done(prepared, failed);
+        }
+
+        void connectionDone() {
+            bool last;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                last = --pendingConnections == 0;
+            }
+            if (last) {
+                finish(0);
+            }
+        }
+    };
+
+    void runWarmUpStatement(const std::shared_ptr<WarmUpState> &state,
+                            const std::shared_ptr<Transaction> &transaction, size_t next);
+
+    // Runs the statements from next on in a new transaction. The other warm-up transactions still hold their
+    // connections, so it gets the one a failed statement's rollback has just given back.
+    void warmUpConnection(const std::shared_ptr<WarmUpState> &state, size_t next) {
+        if (next == state->statements.size()) {
+            state->connectionDone();
+            return;
+        }
+        state->client->newTransactionAsync([state, next](const std::shared_ptr<Transaction> &transaction) {
+            if (!transaction) {
+                state->finish(1);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->finished) {
+                    transaction->rollback();
+                    return;
+                }
+                state->transactions.push_back(transaction);
+            }
+            runWarmUpStatement(state, transaction, next);
+        });
+    }
+
+    // One statement at a time: drogon rolls a transaction back when a statement in it fails, and every statement
+    // queued behind it would fail with it
+    void runWarmUpStatement(const std::shared_ptr<WarmUpState> &state,
+                            const std::shared_ptr<Transaction> &transaction, size_t next) {
+        if (next == state->statements.size()) {
+            state->connectionDone();
+            return;
+        }
+        const auto *statement = state->statements[next];
+        auto binder = *transaction << statement->sql;
+        statement->bindWarmUpArgs(binder);
+        binder >> [state, transaction, next](const Result &) {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->finished) {
+                    return;
+                }
+                ++state->prepared;
+            }
+            runWarmUpStatement(state, transaction, next + 1);
+        };
+        binder >> [state, next, name = statement->name](const DrogonDbException &e) {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->finished) {
+                    return;
+                }
+                ++state->failed;
+            }
+            LOG_ERROR << "Preparing statement " << name << " failed: " << e.base().what();
+            warmUpConnection(state, next + 1);
+        };
+    }
+}
+
+void StatementRegistry::warmUp(const DbClientPtr &client, size_t connections, std::chrono::milliseconds timeout,
+                               std::function<void(size_t prepared, size_t failed)> done) {
+    auto state = std::make_shared<WarmUpState>();
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        for (const auto &entry: statements_) {
+            if (entry.second->bindWarmUpArgs) {
+                state->statements.push_back(entry.second.get());
+            }
+        }
+    }
+    if (!client || connections == 0 || state->statements.empty()) {
+        done(0, 0);
+        return;
+    }
+
+    state->client = client;
+    state->pendingConnections = connections;
+    state->done = std::move(done);
+
+    drogon::app().getLoop()->runAfter(std::chrono::duration<double>(timeout), [state]() {
+        size_t missing;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            missing = state->pendingConnections;
+        }
+        if (missing > 0) {
+            LOG_ERROR << "Statement warm-up timed out with " << missing
+                      << " connection(s) outstanding; is number_of_connections lower than configured, or is a"
+                         " warm-up statement waiting on a row another warm-up transaction holds?";
+        }
+        state->finish(missing);
+    });
+
+    for (size_t i = 0; i < connections; ++i) {
+        warmUpConnection(state, 0);
+    }
+}
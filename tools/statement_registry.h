@@ -0,0 +1,60 @@
+#pragma once
+#include <drogon/orm/DbClient.h>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// One SQL text registered under a stable name. drogon's PostgreSQL client prepares every distinct
+// parameterised text once per connection, so handing out a single canonical text per name is what
+// turns a statement into a reusable prepared statement.
+struct PreparedStatement {
+    using Binder = drogon::orm::internal::SqlBinder;
+
+    std::string name;
+    std::string sql;
+    // binds throwaway arguments of the right types for the warm-up run, which is rolled back; called once per
+    // warm-up connection, and values that land in a unique index must differ between calls
+    std::function<void(Binder &)> bindWarmUpArgs;
+};
+
+// Process-wide registry of the statements issued by the controllers. Statements are registered at
+// startup (see productsControllers::registerStatements) and prepared on every pooled connection by
+// warmUp() before the first request needs them; variants built from request parameters (?fields=)
+// are added on first use and prepared lazily by the driver.
+class StatementRegistry {
+public:
+    static StatementRegistry &instance();
+
+    // Registering a name again with the same text returns the existing entry; a different text throws
+    const PreparedStatement &add(std::string name, std::string sql,
+                                 std::function<void(PreparedStatement::Binder &)> bindWarmUpArgs = nullptr);
+
+    // Throws std::out_of_range for an unknown name
+    const PreparedStatement &get(const std::string &name) const;
+
+    // Entry for name, built by makeSql the first time it is asked for
+    const PreparedStatement &getOrAdd(const std::string &name, const std::function<std::string()> &makeSql);
+
+    std::vector<std::string> names() const;
+
+    size_t size() const;
+
+    // Run every statement that has warm-up arguments inside `connections` concurrent transactions, so each
+    // pooled connection prepares them all, then roll the transactions back. A failed statement does not stop
+    // the ones after it. done receives the number of statements that ran, summed over the connections, and the
+    // number of failures; a pool smaller than `connections` is detected by the timeout and reported as a failure
+    // instead of blocking forever. Only client's own connections are warmed: replicas and DbPool connections
+    // prepare each statement on first use.
+    void warmUp(const drogon::orm::DbClientPtr &client, size_t connections, std::chrono::milliseconds timeout,
+                std::function<void(size_t prepared, size_t failed)> done);
+
+private:
+    StatementRegistry() = default;
+
+    mutable std::shared_mutex mutex_;
+    std::map<std::string, std::unique_ptr<PreparedStatement>> statements_; // unique_ptr keeps references stable
+};
@@ -0,0 +1,62 @@
+#include "stock_counter.h"
+#include <algorithm>
+
+StockCounter::StockCounter(int64_t block) : block_(std::max<int64_t>(block, 1)) {
+}
+
+std::optional<int64_t> StockCounter::reserve(int64_t n) {
+    if (!ready()) {
+        return std::nullopt;
+    }
+    auto current = available_.load(std::memory_order_acquire);
+    while (current >= n) {
+        if (available_.compare_exchange_weak(current, current - n, std::memory_order_acq_rel)) {
+            return current - n;
+        }
+    }
+    // the next transfer leases at least this much
+    auto wanted = wanted_.load(std::memory_order_relaxed);
+    while (wanted < n && !wanted_.compare_exchange_weak(wanted, n, std::memory_order_relaxed)) {
+    }
+    return std::nullopt;
+}
+
+int64_t StockCounter::release(int64_t n) {
+    return available_.fetch_add(n, std::memory_order_acq_rel) + n;
+}
+
+std::optional<int64_t> StockCounter::beginTransfer() {
+    if (transferring_.exchange(true, std::memory_order_acq_rel)) {
+        return std::nullopt;
+    }
+    auto current = available_.load(std::memory_order_acquire);
+    auto wanted = wanted_.load(std::memory_order_relaxed);
+    if (!ready() || current < block_ / 2 || wanted > current) {
+        wanted_.store(0, std::memory_order_relaxed);
+        auto lease = std::max(block_, wanted - current);
+        inFlight_.store(lease, std::memory_order_release);
+        return lease;
+    }
+    // keep one block, give back the rest; a reservation racing with this leaves less to give back
+    while (current > 2 * block_) {
+        if (available_.compare_exchange_weak(current, block_, std::memory_order_acq_rel)) {
+            inFlight_.store(block_ - current, std::memory_order_release);
+            return block_ - current;
+        }
+    }
+    transferring_.store(false, std::memory_order_release);
+    return std::nullopt;
+}
+
+void StockCounter::transferred(int64_t leased) {
+    if (inFlight_.exchange(0, std::memory_order_acq_rel) > 0) {
+        available_.fetch_add(leased, std::memory_order_acq_rel);
+        ready_.store(true, std::memory_order_release);
+    }
+    transferring_.store(false, std::memory_order_release);
+}
+
+void StockCounter::transferFailed() {
+    inFlight_.store(0, std::memory_order_release);
+    transferring_.store(false, std::memory_order_release);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+// In-memory stock of one hot product, leased from its row. The row's quantity is the stock no instance holds;
+// an instance takes blocks of it with one atomic UPDATE and sells only what it holds, so instances never sell the
+// same unit and a reservation only touches an atomic. Releases add to the lease, and whatever grows past two
+// blocks goes back to the row. One transfer between the row and the lease is in flight at a time.
+class StockCounter {
+public:
+    explicit StockCounter(int64_t block = 100);
+
+    // A first lease has been taken; until then reserve() refuses everything
+    bool ready() const {
+        return ready_.load(std::memory_order_acquire);
+    }
+
+    // Units left in the lease after taking n, std::nullopt if fewer than n are held (or not ready yet)
+    std::optional<int64_t> reserve(int64_t n);
+
+    // Units held after putting n back
+    int64_t release(int64_t n);
+
+    int64_t available() const {
+        return available_.load(std::memory_order_acquire);
+    }
+
+    // Units to move now: positive to lease that many from the row, negative to give that many back (they have
+    // already left available()). std::nullopt while the lease is within bounds or a transfer is in flight. The
+    // lease is topped up below half a block, or when a reservation larger than the lease was refused.
+    std::optional<int64_t> beginTransfer();
+
+    // The transfer in flight (0 when none)
+    int64_t inFlight() const {
+        return inFlight_.load(std::memory_order_acquire);
+    }
+
+    // The row handed over leased units (at most what was asked, less when it ran low); for a give-back, pass 0
+    void transferred(int64_t leased);
+
+    // The write failed and may or may not have committed. Taken as having leased nothing and having given back
+    // everything, so the lease never holds a unit the row still counts; the units that may have dropped out of
+    // both are left for the caller to log.
+    void transferFailed();
+
+private:
+    int64_t block_;
+    std::atomic<int64_t> available_{0};
+    std::atomic<int64_t> inFlight_{0};
+    std::atomic<int64_t> wanted_{0}; // largest reservation refused since the last lease
+    std::atomic<bool> transferring_{false};
+    std::atomic<bool> ready_{false};
+};